@@ -1,4 +1,7 @@
 #include "../../src/game.h"
+#include "../../src/arena_list.h"
+#include "../../src/pool.h"
+#include "../../src/sort.h"
 #include <string>
 #include <array>
 #include <queue>
@@ -313,6 +316,11 @@ struct Ember {
 	f32 rotationOffset;
 	f32 drag;
 };
+// NOTE: embers outnumber everything else, so they are stored field by field. Field order matches 'Ember'.
+struct EmberField {
+	enum : umm { position, velocity, color, remainingLifeTime, maxLifeTime, rotationOffset, drag };
+};
+using EmberPool = SoaPool<v2f, v2f, v3f, f32, f32, f32, f32>;
 struct Tile {
 	v4f color;
 
@@ -362,9 +370,10 @@ enum class RaycastResultType { noHit, tile, bot, player };
 struct RaycastResult {
 	RaycastResultType type;
 	u32 target;
+	PoolHandle bot;
 };
 enum RaycastLayer { player = 0x1, bot = 0x2 };
-RaycastResult raycast(TileStorage const *tiles, Span<Bot> bots, Span<v2f> players, v2f a, v2f b, v2f &point,
+RaycastResult raycast(TileStorage const *tiles, Pool<Bot> const *bots, Span<v2f> players, v2f a, v2f b, v2f &point,
 					  v2f &normal) {
 	if (tiles) {
 		v2f tMin, tMax;
@@ -381,11 +390,11 @@ RaycastResult raycast(TileStorage const *tiles, Span<Bot> bots, Span<v2f> player
 			}
 		}
 	}
-	if (bots.size()) {
-		for (auto &bot : bots) {
+	if (bots) {
+		for (auto &bot : *bots) {
 			if (raycastRect(a, moveAway(b, a, max(dot(a - b, bot.velocity), 0)), bot.position, V2f(bot.getRadius()), point,
 							normal)) {
-				return {RaycastResultType::bot, indexOf(&bot, bots)};
+				return {RaycastResultType::bot, 0, bots->handleOf(bot)};
 			}
 		}
 	}
@@ -526,9 +535,9 @@ struct Game {
 
 	World world;
 
-	UnorderedList<Bullet> bullets;
-	UnorderedList<Explosion> explosions;
-	UnorderedList<Ember> embers;
+	Pool<Bullet> bullets;
+	Pool<Explosion> explosions;
+	EmberPool embers;
 
 	::Random random{(u32)time(0)};
 
@@ -538,14 +547,17 @@ struct Game {
 	BufferId tilesBuffer, lightsBuffer, debugLineBuffer;
 
 	LightAtlas lightAtlas;
-	UnorderedList<LightTile, TempAllocator> allRaycastTargets;
+	UnorderedList<LightTile, FrameAllocator> allRaycastTargets;
 	
-	List<Tile, TempAllocator> tilesToDraw;
-	List<Light, TempAllocator> lightsToDraw;
+	ArenaList<Tile, FrameAllocator> tilesToDraw;
+	ArenaList<Light, FrameAllocator> lightsToDraw;
+	// Last frame's targets, valid until the next frame begins. The light atlas casts against these, so it doesn't wait
+	// for this frame's draw lists.
+	UnorderedList<LightTile, FrameAllocator> previousRaycastTargets;
 
 	f32 botSpawnTimer;
 	f32 botSpawnDelta = 1.23456789f;
-	UnorderedList<Bot> bots;
+	Pool<Bot> bots;
 	u32 botsKilled;
 	u32 currentWave;
 	bool spawnBots;
@@ -560,6 +572,10 @@ struct Game {
 	bool hasUltimateAttack() { return ultimateAttackPercent == 100; }
 
 	UnorderedList<SoundBuffer> music;
+	// NOTE: tracks are streamed in on the background lane and moved to 'music' when the playlist restarts,
+	// so 'playingMusic' never points into a list that is growing
+	List<Future<SoundBuffer>> loadingMusic;
+	CancellationToken musicCancellation;
 	SoundBuffer shotSound, explosionSound, ultimateSound, coinSound;
 
 	struct PlayingSound {
@@ -631,7 +647,7 @@ struct Game {
 		f32 lifeTime = 0.0f;
 	};
 
-	UnorderedList<Coin> coinDrops;
+	Pool<Coin> coinDrops;
 	u32 coinsInWallet;
 	static constexpr f32 coinRadius = 0.25f;
 
@@ -655,6 +671,8 @@ struct Game {
 
 	struct DebugProfile {
 		f32 raycastMS;
+		f32 frameGraphMS;
+		f32 serialFrameGraphMS;
 		u8 mode;
 	};
 	DebugProfile debugProfile{};
@@ -663,7 +681,7 @@ struct Game {
 		v2f a, b;
 		v4f color;
 	};
-	List<DebugLine, TempAllocator> debugLines;
+	ArenaList<DebugLine, FrameAllocator> debugLines;
 
 	void pushDebugLine(v2f a, v2f b, v4f color) {
 		DebugLine result;
@@ -687,6 +705,7 @@ struct Game {
 	bool debugUpdateBots = true;
 	bool debugGod = false;
 	bool debugSun = false;
+	bool debugSerialFrameGraph = false;
 	
 	enum class DebugValueType { u1, u8, u16, u32, u64, s8, s16, s32, s64 };
 
@@ -722,9 +741,12 @@ struct Game {
 
 	RaycastResult raycast(u32 ignoredLayers, v2f a, v2f b, v2f &point, v2f &normal) {
 		Span players = {&playerP, 1};
-		return ::raycast(&world.tiles, (ignoredLayers & RaycastLayer::bot) ? Span<Bot>{} : bots,
+		return ::raycast(&world.tiles, (ignoredLayers & RaycastLayer::bot) ? 0 : &bots,
 						 (ignoredLayers & RaycastLayer::player) ? Span<v2f>{} : players, a, b, point, normal);
 	}
+	void addEmber(Ember const &e) {
+		embers.add(e.position, e.velocity, e.color, e.remainingLifeTime, e.maxLifeTime, e.rotationOffset, e.drag);
+	}
 	void spawnEmbers(v2f position, v2f incoming, v2f normal) {
 		v2f nin = normalize(incoming);
 		f32 range = -dot(nin, normal);
@@ -742,7 +764,7 @@ struct Game {
 			e.rotationOffset = rnd[3] * (2 * pi);
 			e.drag = 10.0f;
 			e.color = v3f{1, .5, .2};
-			embers.push_back(e);
+			addEmber(e);
 		}
 	
 		pushExplosionSound(position);
@@ -752,7 +774,7 @@ struct Game {
 		ex.position = position;
 		ex.maxLifeTime = ex.remainingLifeTime = 0.5f + random.f32() * 0.25f;
 		ex.rotationOffset = random.f32() * (2 * pi);
-		explosions.push_back(ex);
+		explosions.add(ex);
 
 		spawnEmbers(position, incoming, normal);
 	}
@@ -764,7 +786,7 @@ struct Game {
 		b.rotation = rotation;
 		sincos(rotation, b.velocity.y, b.velocity.x);
 		b.velocity *= velocity;
-		bullets.push_back(b);
+		bullets.add(b);
 	}
 	void spawnBullet(u32 ignoredLayers, v2f position, v2f velocity, u32 damage) {
 		Bullet b;
@@ -773,7 +795,7 @@ struct Game {
 		b.position = position;
 		b.velocity = velocity;
 		b.rotation = atan2(normalize(velocity));
-		bullets.push_back(b);
+		bullets.add(b);
 	}
 
 	void spawnBot(v2f position, bool boss) {
@@ -781,18 +803,14 @@ struct Game {
 		newBot.isBoss = boss;
 		newBot.health = (s32)(boss ? currentWave * 5 : currentWave);
 		newBot.position = position;
-		bots.push_back(newBot);
+		bots.add(newBot);
 		++totalBotsSpawned;
 	}
 	
 	NOINLINE void pushRaycastTarget(v2f pos, f32 radius, v3f color) {
-		LightTile t;
-		t.boxMin = pos - radius;
-		t.boxMax = pos + radius;
-		t.color = color;
-		allRaycastTargets.push_back(t);
+		allRaycastTargets.push_back(createRaycastTarget(pos, radius, color));
 	}
-	void pushTile(List<Tile, TempAllocator> &list, v2f position, v2f uv0, v2f uv1, f32 uvMix, v2f uvScale, v2f size = V2f(1.0f), f32 rotation = 0.0f,
+	static Tile createTile(v2f position, v2f uv0, v2f uv1, f32 uvMix, v2f uvScale, v2f size = V2f(1.0f), f32 rotation = 0.0f,
 					v4f color = V4f(1)) {
 		Tile t{};
 		t.position = position;
@@ -803,9 +821,18 @@ struct Game {
 		t.rotation = rotation;
 		t.size = size;
 		t.color = color;
-		list.push_back(t);
+		return t;
+	}
+	static Tile createTile(v2f position, v2f uv0, v2f uvScale, v2f size = V2f(1.0f), f32 rotation = 0.0f, v4f color = V4f(1)) {
+		return createTile(position, uv0, {}, 0, uvScale, size, rotation, color);
+	}
+	template <class Allocator>
+	void pushTile(ArenaList<Tile, Allocator> &list, v2f position, v2f uv0, v2f uv1, f32 uvMix, v2f uvScale, v2f size = V2f(1.0f), f32 rotation = 0.0f,
+					v4f color = V4f(1)) {
+		list.push_back(createTile(position, uv0, uv1, uvMix, uvScale, size, rotation, color));
 	}
-	void pushTile(List<Tile, TempAllocator> &list, v2f position, v2f uv0, v2f uvScale, v2f size = V2f(1.0f), f32 rotation = 0.0f, v4f color = V4f(1)) {
+	template <class Allocator>
+	void pushTile(ArenaList<Tile, Allocator> &list, v2f position, v2f uv0, v2f uvScale, v2f size = V2f(1.0f), f32 rotation = 0.0f, v4f color = V4f(1)) {
 		pushTile(list, position, uv0, {}, 0, uvScale, size, rotation, color);
 	}
 	void pushTile(v2f position, v2f uv0, v2f uv1, f32 uvMix, v2f uvScale, v2f size = V2f(1.0f), f32 rotation = 0.0f, v4f color = V4f(1)) {
@@ -814,18 +841,41 @@ struct Game {
 	void pushTile(v2f position, v2f uv0, v2f uvScale, v2f size = V2f(1.0f), f32 rotation = 0.0f, v4f color = V4f(1)) {
 		pushTile(tilesToDraw, position, uv0, {}, 0, uvScale, size, rotation, color);
 	}
-	void pushLight(v3f color, v2f position, f32 radius, v2f clientSize) {
+	Light createLight(v3f color, v2f position, f32 radius, v2f clientSize) {
 		Light l;
 		l.color = color;
 		l.radius = camZoom * radius * 2;
 		l.position = (position - cameraP) * camZoom;
 		l.position.x *= clientSize.y / clientSize.x;
-		lightsToDraw.push_back(l);
+		return l;
+	}
+	void pushLight(v3f color, v2f position, f32 radius, v2f clientSize) {
+		lightsToDraw.push_back(createLight(color, position, radius, clientSize));
+	}
+	static LightTile createRaycastTarget(v2f pos, f32 radius, v3f color) {
+		LightTile t;
+		t.boxMin = pos - radius;
+		t.boxMax = pos + radius;
+		t.color = color;
+		return t;
+	}
+	// NOTE: grows the list by 'count' elements and returns them, so a parallel loop can fill them by index
+	template <class T, class Allocator>
+	static Span<T> appendSlots(ArenaList<T, Allocator> &list, umm count) {
+		umm offset = list.size();
+		list.resize(offset + count);
+		return Span{list.data() + offset, count};
+	}
+	template <class T, class Allocator>
+	static Span<T> appendSlots(UnorderedList<T, Allocator> &list, umm count) {
+		umm offset = list.size();
+		list.resize(offset + count);
+		return Span{list.data() + offset, count};
 	}
 
 	void drawText(Renderer &renderer, Span<Label> labels, v2f clientSize) {
-		tilesToDraw.clear();
-		tilesToDraw.reserve(labels.size() * 64);
+		ArenaList<Tile> textTiles;
+		textTiles.reserve(labels.size() * 64);
 		for (auto &l : labels) {
 			v2f p = l.p / (v2f)letterSize;
 			p.y *= -1;
@@ -848,37 +898,37 @@ struct Game {
 				t.uvScale = V2f(1.0f / 16.0f);
 				t.size = V2f(1.0f);
 				t.color = {0,0,0,l.color.w};
-				tilesToDraw.push_back(t);
+				textTiles.push_back(t);
 				t.color = l.color;
 				t.position = basePosition;
-				tilesToDraw.push_back(t);
+				textTiles.push_back(t);
 				column += 1.0f;
 			}
 		}
-		renderer.updateBuffer(tilesBuffer, tilesToDraw.data(), (u32)tilesToDraw.size() * sizeof(tilesToDraw[0]));
+		renderer.updateBuffer(tilesBuffer, textTiles.data(), (u32)textTiles.size() * sizeof(textTiles[0]));
 
 		renderer.setBlend(Blend::srcAlpha, Blend::invSrcAlpha, BlendOp::add);
 		renderer.bindShader(basicTileShader);
 		renderer.bindBuffer(tilesBuffer, Stage::vs, 0);
 		renderer.bindTexture(fontTexture, Stage::ps, 0);
 		renderer.setMatrix(0, m4::translation(-1, 1, 0) * m4::scaling(2 * (v2f)letterSize / clientSize, 0));
-		renderer.draw((u32)tilesToDraw.size() * 6, 0);
+		renderer.draw((u32)textTiles.size() * 6, 0);
 	}
 	void drawRect(Renderer &renderer, Span<Rect> rects, v2f clientSize) {
-		tilesToDraw.clear();
-		tilesToDraw.reserve(rects.size());
+		ArenaList<Tile> rectTiles;
+		rectTiles.reserve(rects.size());
 		for (auto r : rects) {
 			r.pos.y = (s32)clientSize.y - r.pos.y;
-			pushTile((v2f)r.pos + (v2f)r.size * V2f(0.5f, -0.5f), {}, {}, (v2f)r.size, 0, r.color);
+			pushTile(rectTiles, (v2f)r.pos + (v2f)r.size * V2f(0.5f, -0.5f), {}, {}, (v2f)r.size, 0, r.color);
 		}
-		renderer.updateBuffer(tilesBuffer, tilesToDraw.data(), (u32)tilesToDraw.size() * sizeof(tilesToDraw[0]));
+		renderer.updateBuffer(tilesBuffer, rectTiles.data(), (u32)rectTiles.size() * sizeof(rectTiles[0]));
 
 		renderer.setMatrix(0, m4::translation(-1, -1, 0) * m4::scaling(2.0f / clientSize, 0));
 
 		renderer.setBlend(Blend::srcAlpha, Blend::invSrcAlpha, BlendOp::add);
 		renderer.bindShader(solidShader);
 		renderer.bindBuffer(tilesBuffer, Stage::vs, 0);
-		renderer.draw((u32)tilesToDraw.size() * 6, 0);
+		renderer.draw((u32)rectTiles.size() * 6, 0);
 	}
 
 	void setShopOpen(bool open) {
@@ -941,6 +991,16 @@ struct Game {
 	std::mt19937 mt{std::random_device{}()};
 	void playNextMusic() {
 		auto generatePlaylist = [&]() {
+			List<Future<SoundBuffer>> stillLoading;
+			for (auto &track : loadingMusic) {
+				if (track.cancelled())
+					continue;
+				if (track.ready())
+					music.push_back(track.get());
+				else
+					stillLoading.push_back(track);
+			}
+			loadingMusic = std::move(stillLoading);
 			std::shuffle(music.begin(), music.end(), mt);
 			playingMusic.buffer = music.begin();
 		};
@@ -1044,17 +1104,42 @@ struct Game {
 		}
 	};
 
+	template <class Pool>
+	struct SoaSaveVar {
+		Pool &pool;
+		char const *name;
+		SoaSaveVar(Pool &pool, char const *name) : pool(pool), name(name) {}
+		
+		void write(StringBuilder<TempAllocator> &builder) {
+			umm size = pool.size();
+			builder.append(Span{(char *)&size, sizeof(size)});
+			if (size) {
+				pool.forEachColumn([&](auto *column) { builder.append(Span{(char *)column, size * sizeof(*column)}); });
+			}
+		}
+		umm read(void const *from) {
+			umm size = *(umm*)from;
+			pool.resize(size);
+			umm offset = sizeof(umm);
+			pool.forEachColumn([&](auto *column) {
+				memcpy(column, (char *)from + offset, size * sizeof(*column));
+				offset += size * sizeof(*column);
+			});
+			return offset;
+		}
+	};
+
 	template <class T> static constexpr bool isSpanSaveVar = false;
 	template <class T> static constexpr bool isSpanSaveVar<SpanSaveVar<T>> = true;
 
 	List<
 		std::variant<
 			BaseSaveVar, 
-			SpanSaveVar<UnorderedList<Coin>>,
-			SpanSaveVar<UnorderedList<Bullet>>,
-			SpanSaveVar<UnorderedList<Bot>>,
-			SpanSaveVar<UnorderedList<Explosion>>,
-			SpanSaveVar<UnorderedList<Ember>>
+			SpanSaveVar<Pool<Coin>>,
+			SpanSaveVar<Pool<Bullet>>,
+			SpanSaveVar<Pool<Bot>>,
+			SpanSaveVar<Pool<Explosion>>,
+			SoaSaveVar<EmberPool>
 		>
 	> saveVars;
 
@@ -1068,6 +1153,14 @@ struct Game {
 	void saveVar(UnorderedList<T> &var, char const *name) { 
 		saveVars.emplace_back(SpanSaveVar(var, name)); 
 	}
+	template <class T> 
+	void saveVar(Pool<T> &var, char const *name) { 
+		saveVars.emplace_back(SpanSaveVar(var, name)); 
+	}
+	template <class ...Fields> 
+	void saveVar(SoaPool<Fields...> &var, char const *name) { 
+		saveVars.emplace_back(SoaSaveVar(var, name)); 
+	}
 
 	void init() {
 		PROFILE_FUNCTION;
@@ -1078,29 +1171,26 @@ struct Game {
 		lightAtlas.optimizedUpdate = (decltype(lightAtlas.optimizedUpdate))getOptimizedProcAddress("updateLightAtlas");
 		ASSERT(estimateLightPerformance(lightAtlas, estimatedLightAtlasHeight, enableCheckerboard, skipLightUpdateFrame));
 
-		WorkQueue work;
+		TaskGroup loading;
 
-		work.push(&Game::initDebug, this);
+		loading.push([this] { initDebug(); });
 
-		std::mutex musicMutex;
 		for (u32 i = 0; ; ++i) {
-			auto path = format(DATA "audio/music{}.wav", i);
-			if (fileExists(path)) {
-				work.push([this, &musicMutex, path] { 
-					auto m = loadWaveFile(path);
-					musicMutex.lock();
-					music.push_back(m);
-					musicMutex.unlock();
-				});
-			} else {
+			auto path = formatAndTerminate<HeapAllocator>(DATA "audio/music{}.wav", i);
+			if (!fileExists(path.data()))
 				break;
+			if (i == 0) {
+				// NOTE: first track is needed right away, the rest can take as many frames as it needs
+				loading.push([this, path] { music.push_back(loadWaveFile(path.data())); });
+			} else {
+				loadingMusic.push_back(pushPersistent([path] { return loadWaveFile(path.data()); }, JobPriority::background, &musicCancellation));
 			}
 		}
 
-		work.push([&]{ shotSound = loadWaveFile(DATA "audio/shot.wav");});
-		work.push([&]{ explosionSound = loadWaveFile(DATA "audio/explosion.wav");});
-		work.push([&]{ ultimateSound = loadWaveFile(DATA "audio/ultimate.wav");});
-		work.push([&]{ coinSound = loadWaveFile(DATA "audio/coin.wav");});
+		loading.push([&]{ shotSound = loadWaveFile(DATA "audio/shot.wav");});
+		loading.push([&]{ explosionSound = loadWaveFile(DATA "audio/explosion.wav");});
+		loading.push([&]{ ultimateSound = loadWaveFile(DATA "audio/ultimate.wav");});
+		loading.push([&]{ coinSound = loadWaveFile(DATA "audio/coin.wav");});
 		
 		world.tiles = genTiles();
 		world.graph = createGraph(world.tiles);
@@ -1162,8 +1252,9 @@ struct Game {
 		SAVE_VAR(debugUpdateBots);
 		SAVE_VAR(debugGod);
 		SAVE_VAR(debugSun);
+		SAVE_VAR(debugSerialFrameGraph);
 
-		work.completeAllWork();
+		loading.wait();
 		
 		playNextMusic();
 
@@ -1202,55 +1293,37 @@ struct Game {
 #endif
 		//time.targetDelta = 0.0f;
 
-		WorkQueue work;
-
-		work.push([&]{ 
-			basicTileShader = renderer.createShader(DATA "shaders/tile");
-		});
-		work.push([&]{ 
-			StaticList<ShaderMacro, 4> macros;
-			macros.push_back({"NORMAL_OUTPUT"});
-			macros.push_back({"CLIP_ALPHA"});
-			tileShader = renderer.createShader(DATA "shaders/tile", macros);
-		});
-		work.push([&]{ 
-			StaticList<ShaderMacro, 4> macros;
-			macros.push_back({"SOLID"});
-			solidShader    = renderer.createShader(DATA "shaders/tile", macros);
-		});
-		work.push([&]{ lightShader    = renderer.createShader(DATA "shaders/light");});
-		work.push([&]{ 
-			char roughSampleCountTxt[16];
-			StaticList<ShaderMacro, 4> macros;
-			macros.push_back({"ROUGH_SAMPLE_COUNT", toStringNT(ROUGH_SAMPLE_COUNT, roughSampleCountTxt).data()});
-			macros.push_back({"TO_DIFFUSE"});
-			diffusorShader = renderer.createShader(DATA "shaders/diffusor", macros);
-		});
-		work.push([&]{ 
-			char roughSampleCountTxt[16];
-			StaticList<ShaderMacro, 4> macros;
-			macros.push_back({"ROUGH_SAMPLE_COUNT", toStringNT(ROUGH_SAMPLE_COUNT, roughSampleCountTxt).data()});
-			macros.push_back({"TO_POINT"});
-			diffusorToPointShader = renderer.createShader(DATA "shaders/diffusor", macros);
-		});
-		work.push([&]{ 
-			char sampleCountTxt[16];
-			char roughSampleCountTxt[16];
-			StaticList<ShaderMacro, 4> macros;
-			macros.push_back({"LIGHT_SAMPLE_COUNT", toStringNT(lightAtlas.sampleCount, sampleCountTxt).data()});
-			macros.push_back({"ROUGH_SAMPLE_COUNT", toStringNT(ROUGH_SAMPLE_COUNT, roughSampleCountTxt).data()});
-			macros.push_back({"TO_SPECULAR"});
-			rougherShader = renderer.createShader(DATA "shaders/diffusor", macros);
-		});
-		work.push([&]{ lineShader   = renderer.createShader(DATA "shaders/line");});
-		work.push([&]{ tilesBuffer  = renderer.createBuffer(0, sizeof(Tile), MAX_TILES);});
-		work.push([&]{ lightsBuffer = renderer.createBuffer(0, sizeof(Light), MAX_LIGHTS);});
-		work.push([&]{ debugLineBuffer = renderer.createBuffer(0, sizeof(DebugLine), 1024 * 8);});
-		work.push([&]{ atlasAlbedo = renderer.createTexture(DATA "textures/atlas_albedo.png", Address::clamp, Filter::point_point);});
-		work.push([&]{ atlasNormal = renderer.createTexture(DATA "textures/atlas_normal.png", Address::clamp, Filter::point_point);});
-		work.push([&]{ fontTexture = renderer.createTexture(DATA "textures/font.png", Address::clamp, Filter::point_point);});
+		// NOTE: shader tasks keep references to macros and results, everything they use lives until 'loading.wait'
+		TaskGroup loading;
+
+		char sampleCountTxt[16];
+		char roughSampleCountTxt[16];
+		char const *sampleCount = toStringNT(lightAtlas.sampleCount, sampleCountTxt).data();
+		char const *roughSampleCount = toStringNT(ROUGH_SAMPLE_COUNT, roughSampleCountTxt).data();
+
+		ShaderMacro const tileMacros[] = {{"NORMAL_OUTPUT"}, {"CLIP_ALPHA"}};
+		ShaderMacro const solidMacros[] = {{"SOLID"}};
+		ShaderMacro const diffusorMacros[] = {{"ROUGH_SAMPLE_COUNT", roughSampleCount}, {"TO_DIFFUSE"}};
+		ShaderMacro const diffusorToPointMacros[] = {{"ROUGH_SAMPLE_COUNT", roughSampleCount}, {"TO_POINT"}};
+		ShaderMacro const rougherMacros[] = {{"LIGHT_SAMPLE_COUNT", sampleCount}, {"ROUGH_SAMPLE_COUNT", roughSampleCount}, {"TO_SPECULAR"}};
+
+		loading.push(renderer.createShaderTask(DATA "shaders/tile", basicTileShader));
+		loading.push(renderer.createShaderTask(DATA "shaders/tile", Span(tileMacros, _countof(tileMacros)), tileShader));
+		loading.push(renderer.createShaderTask(DATA "shaders/tile", Span(solidMacros, _countof(solidMacros)), solidShader));
+		loading.push(renderer.createShaderTask(DATA "shaders/light", lightShader));
+		loading.push(renderer.createShaderTask(DATA "shaders/diffusor", Span(diffusorMacros, _countof(diffusorMacros)), diffusorShader));
+		loading.push(renderer.createShaderTask(DATA "shaders/diffusor", Span(diffusorToPointMacros, _countof(diffusorToPointMacros)), diffusorToPointShader));
+		loading.push(renderer.createShaderTask(DATA "shaders/diffusor", Span(rougherMacros, _countof(rougherMacros)), rougherShader));
+		loading.push(renderer.createShaderTask(DATA "shaders/line", lineShader));
+		// NOTE: nothing to prepare for buffers, only the device calls are left and those belong to the render thread
+		loading.push(NamedThread::main, [&]{ tilesBuffer  = renderer.createBuffer(0, sizeof(Tile), MAX_TILES);});
+		loading.push(NamedThread::main, [&]{ lightsBuffer = renderer.createBuffer(0, sizeof(Light), MAX_LIGHTS);});
+		loading.push(NamedThread::main, [&]{ debugLineBuffer = renderer.createBuffer(0, sizeof(DebugLine), 1024 * 8);});
+		loading.push(renderer.createTextureTask(DATA "textures/atlas_albedo.png", Address::clamp, Filter::point_point, atlasAlbedo));
+		loading.push(renderer.createTextureTask(DATA "textures/atlas_normal.png", Address::clamp, Filter::point_point, atlasNormal));
+		loading.push(renderer.createTextureTask(DATA "textures/font.png", Address::clamp, Filter::point_point, fontTexture));
 		
-		work.completeAllWork();
+		loading.wait();
 	}
 	void debugReload() {
 		upgrades.clear();
@@ -1326,7 +1399,7 @@ struct Game {
 		PROFILE_FUNCTION;
 		for (auto &bot : bots) {
 			v2f hitPoint, hitNormal;
-			auto raycastResult = ::raycast(&world.tiles, {}, {&playerP, 1}, bot.position, playerP, hitPoint, hitNormal).type;
+			auto raycastResult = ::raycast(&world.tiles, 0, {&playerP, 1}, bot.position, playerP, hitPoint, hitNormal).type;
 					
 			f32 const botFireDelta = 120.0f / 113.5f;
 
@@ -1409,7 +1482,7 @@ struct Game {
 			auto &bullet = bullets[i];
 			bullet.remainingLifetime -= scaledDelta;
 			if (bullet.remainingLifetime <= 0) {
-				erase(bullets, bullet);
+				bullets.erase(bullet);
 				--i;
 				continue;
 			}
@@ -1427,7 +1500,7 @@ struct Game {
 						f32 angle = random.f32() * pi * 2;
 						sincos(angle, newCoin.velocity.x, newCoin.velocity.y);
 						newCoin.velocity *= 3 * (1 + random.f32());
-						coinDrops.push_back(newCoin);
+						coinDrops.add(newCoin);
 					}
 
 					++botsKilled;
@@ -1441,7 +1514,8 @@ struct Game {
 				return false;
 			};
 			if (raycastResult.type == RaycastResultType::bot) {
-				damageBot(bots[raycastResult.target], bullet.damage);
+				if (auto bot = bots.get(raycastResult.bot))
+					damageBot(*bot, bullet.damage);
 			} else if (raycastResult.type == RaycastResultType::player) {
 				if (playerHealth > 0 && !debugGod) {
 					playerHealth -= bullet.damage;
@@ -1474,7 +1548,7 @@ struct Game {
 				} else {
 					spawnEmbers(hitPoint, normalize(bullet.velocity), hitNormal);
 				}
-				erase(bullets, bullet);
+				bullets.erase(bullet);
 				--i;
 				continue;
 			}
@@ -1488,7 +1562,7 @@ struct Game {
 			auto &e = explosions[i];
 			e.remainingLifeTime -= scaledDelta;
 			if (e.remainingLifeTime <= 0) {
-				erase(explosions, e);
+				explosions.erase(e);
 				--i;
 				continue;
 			}
@@ -1496,15 +1570,21 @@ struct Game {
 	}
 	void updateEmbers(f32 scaledDelta) {
 		PROFILE_FUNCTION;
-		for (auto e = embers.begin(); e != embers.end();) {
-			e->remainingLifeTime -= scaledDelta;
-			if (e->remainingLifeTime <= 0) {
-				erase(embers, e);
+		f32 *remainingLifeTimes = embers.column<EmberField::remainingLifeTime>();
+		for (u32 i = 0; i < embers.size();) {
+			remainingLifeTimes[i] -= scaledDelta;
+			if (remainingLifeTimes[i] <= 0) {
+				embers.eraseAt(i);
 				continue;
 			}
-			e->position += e->velocity * scaledDelta;
-			e->velocity = moveTowards(e->velocity, {}, scaledDelta * e->drag);
-			++e;
+			++i;
+		}
+		v2f *positions = embers.column<EmberField::position>();
+		v2f *velocities = embers.column<EmberField::velocity>();
+		f32 *drags = embers.column<EmberField::drag>();
+		for (u32 i = 0; i < embers.size(); ++i) {
+			positions[i] += velocities[i] * scaledDelta;
+			velocities[i] = moveTowards(velocities[i], {}, scaledDelta * drags[i]);
 		}
 	}
 	void updateCoins(f32 scaledDelta) {
@@ -1528,9 +1608,21 @@ struct Game {
 			++c;
 		}
 	}
+	// Written before the save vars. Vars are stored raw, so a file from another version can't be read back.
+	// NOTE: bump 'currentVersion' whenever save vars are added, removed, reordered or change layout
+	struct SaveHeader {
+		// "DSAV" in the file
+		static constexpr u32 currentMagic = 0x56415344;
+		// 1: headerless files from before embers were saved column by column and 'debugSerialFrameGraph' was added
+		static constexpr u32 currentVersion = 2;
+		u32 magic;
+		u32 version;
+	};
 	void saveState() {
 		Log::print("saving...");
 		StringBuilder<TempAllocator> builder;
+		SaveHeader header{SaveHeader::currentMagic, SaveHeader::currentVersion};
+		builder.append(Span{(char *)&header, sizeof(header)});
 		for (auto &s : saveVars) {
 			std::visit([&](auto &var) { var.write(builder); }, s);
 		}
@@ -1541,16 +1633,32 @@ struct Game {
 	}
 	void loadState() {
 		Log::print("loading...");
-		auto file = readEntireFile("save.bin");
-		umm offset = 0;
+		auto file = readEntireFile("save.bin", MemoryTag::save);
+		if (!file.valid) {
+			Log::warn("no save file");
+			return;
+		}
+		DEFER { freeEntireFile(file); };
+
+		SaveHeader header{};
+		if (file.data.size() >= sizeof(header))
+			memcpy(&header, file.data.data(), sizeof(header));
+		if (header.magic != SaveHeader::currentMagic || header.version != SaveHeader::currentVersion) {
+			// NOTE: old files have no header at all, they are version 1
+			Log::warn("save file is from version {}, this build reads {} only", header.magic == SaveHeader::currentMagic ? header.version : 1, SaveHeader::currentVersion);
+			return;
+		}
+		umm offset = sizeof(header);
 		for (auto &s : saveVars) {
 			std::visit([&](auto &var) { offset += var.read(file.data.data() + offset); }, s);
 		}
-		freeEntireFile(file);
 	}
 	void update(Window &window, Renderer &renderer, Input &input, Time &time) {
 		PROFILE_FUNCTION;
 
+		// NOTE: these are in frame memory. Last frame's targets move to 'previousRaycastTargets' and stay intact for this
+		// frame, the ones they replace are from two frames ago, their arena was reset when this frame began.
+		previousRaycastTargets = std::move(allRaycastTargets);
 		debugLines = {};
 		allRaycastTargets = {};
 		tilesToDraw = {};
@@ -1607,6 +1715,7 @@ struct Game {
 			debugUpdateBots ^= input.keyDown('B');
 			debugGod ^= input.keyDown('G');
 			spawnBots ^= input.keyDown('S');
+			debugSerialFrameGraph ^= input.keyDown('J');
 			if (input.keyDown('L')) {
 				debugSun ^= 1;
 				if (debugSun) {
@@ -1621,7 +1730,7 @@ struct Game {
 					Coin coin{};
 					f32 a = random.f32() * 2 * pi;
 					coin.position = playerP + v2f{sin(a), cos(a)} * (1.0f + 2.0f * random.f32());
-					coinDrops.push_back(coin);
+					coinDrops.add(coin);
 				}
 			}
 			if (input.keyHeld('V')) {
@@ -1750,7 +1859,7 @@ struct Game {
 				e.rotationOffset = 2 * pi * random.f32();
 				e.drag = 0.0f;
 				e.color = v3f{.3, .6, 1};
-				embers.push_back(e);
+				addEmber(e);
 			}
 
 			updateExplosions(scaledDelta);
@@ -1808,11 +1917,11 @@ struct Game {
 				botPositions.reserve(bots.size());
 				for (auto &b : bots) {
 					v2f point, normal;
-					if(::raycast(&world.tiles, bots, {}, playerP, b.position, point, normal).type == RaycastResultType::bot) {
+					if(::raycast(&world.tiles, &bots, {}, playerP, b.position, point, normal).type == RaycastResultType::bot) {
 						botPositions.push_back(b.position);
 					}
 				}
-				std::sort(botPositions.begin(), botPositions.end(), [this](v2f a, v2f b){ return distanceSqr(playerP, a) < distanceSqr(playerP, b); });
+				radixSort(botPositions.begin(), botPositions.end(), [this](v2f position) { return toRadixKey(distanceSqr(playerP, position)); });
 
 				u32 ultimateRepeatIndex = (u32)ultimateAttackRepeatTimer;
 				for(u32 j = ultimateRepeatIndex; j != lastUltimateRepeatIndex; ++j) {
@@ -1856,78 +1965,409 @@ struct Game {
 			test.push_back({});
 #endif
 
-		allRaycastTargets.reserve(1024);
+		auto buildDrawLists = [&] {
+			allRaycastTargets.reserve(1024);
 
-		for (u32 x = 0; x < CHUNK_WIDTH; ++x) {
-			for (u32 y = 0; y < CHUNK_WIDTH; ++y) {
-				if (getTile(world.tiles, x, y)) {
-					pushRaycastTarget((v2f)v2u{x, y}, 0.5f, V3f(0.02f));
-					pushTile((v2f)v2u{x, y}, offsetAtlasTile(4, 7), ATLAS_ENTRY_SIZE);
-				} else {
-					pushTile((v2f)v2u{x, y}, offsetAtlasTile((f32)(randomize(x) % 2), (f32)(randomize(y) % 2)), ATLAS_ENTRY_SIZE, V2f(1), (randomize(x ^ y) % 4) * .5f * pi);
+			auto gridTiles = appendSlots(tilesToDraw, CHUNK_WIDTH * CHUNK_WIDTH);
+			parallelFor(CHUNK_WIDTH, [&](u32 x) {
+				for (u32 y = 0; y < CHUNK_WIDTH; ++y) {
+					Tile &tile = gridTiles[x * CHUNK_WIDTH + y];
+					if (getTile(world.tiles, x, y)) {
+						tile = createTile((v2f)v2u{x, y}, offsetAtlasTile(4, 7), ATLAS_ENTRY_SIZE);
+					} else {
+						tile = createTile((v2f)v2u{x, y}, offsetAtlasTile((f32)(randomize(x) % 2), (f32)(randomize(y) % 2)), ATLAS_ENTRY_SIZE, V2f(1), (randomize(x ^ y) % 4) * .5f * pi);
+					}
+				}
+			});
+			for (u32 x = 0; x < CHUNK_WIDTH; ++x) {
+				for (u32 y = 0; y < CHUNK_WIDTH; ++y) {
+					if (getTile(world.tiles, x, y)) {
+						pushRaycastTarget((v2f)v2u{x, y}, 0.5f, V3f(0.02f));
+					}
 				}
 			}
-		}
-		pushTile(V2f(CHUNK_WIDTH/2 + 0.5f), offsetAtlasTile(2, 0), ATLAS_ENTRY_SIZE * v2f{2, 2}, {2, 2});
+			pushTile(V2f(CHUNK_WIDTH/2 + 0.5f), offsetAtlasTile(2, 0), ATLAS_ENTRY_SIZE * v2f{2, 2}, {2, 2});
 		
-		for (auto &e : embers) {
-			f32 t = e.remainingLifeTime / e.maxLifeTime;
-			f32 tt = t * t;
-			auto uvs = getFrameUvs(1 - t, 16, 4, {2, 7}, 0.25f, false);
-			pushTile(e.position, uvs.uv0, uvs.uv1, uvs.uvMix, ATLAS_ENTRY_SIZE * 0.25f, V2f(map(tt, 0, 1, 0.1f, 0.25f)), t * 3 + e.rotationOffset, V4f(e.color * 2, 1));
-			pushLight(e.color * tt * 2, e.position, .5f, (v2f)window.clientSize);
-		}
+			auto emberTiles = appendSlots(tilesToDraw, embers.size());
+			auto emberLights = appendSlots(lightsToDraw, embers.size());
+			parallelFor((u32)embers.size(), [&](u32 i) {
+				v2f position = embers.get<EmberField::position>(i);
+				v3f color = embers.get<EmberField::color>(i);
+				f32 t = embers.get<EmberField::remainingLifeTime>(i) / embers.get<EmberField::maxLifeTime>(i);
+				f32 tt = t * t;
+				auto uvs = getFrameUvs(1 - t, 16, 4, {2, 7}, 0.25f, false);
+				emberTiles[i] = createTile(position, uvs.uv0, uvs.uv1, uvs.uvMix, ATLAS_ENTRY_SIZE * 0.25f, V2f(map(tt, 0, 1, 0.1f, 0.25f)), t * 3 + embers.get<EmberField::rotationOffset>(i), V4f(color * 2, 1));
+				emberLights[i] = createLight(color * tt * 2, position, .5f, (v2f)window.clientSize);
+			});
 		
-		for (auto &c : coinDrops) {
-			auto uvs = getFrameUvs(frac(c.lifeTime), 6, 6, {0, 4}, 1);
+			auto coinTiles = appendSlots(tilesToDraw, coinDrops.size());
+			auto coinTargets = appendSlots(allRaycastTargets, coinDrops.size());
+			parallelFor((u32)coinDrops.size(), [&](u32 i) {
+				auto &c = coinDrops[i];
+				auto uvs = getFrameUvs(frac(c.lifeTime), 6, 6, {0, 4}, 1);
 
-			pushTile(c.position, uvs.uv0, uvs.uv1, uvs.uvMix, ATLAS_ENTRY_SIZE, V2f(0.5f));
-			pushRaycastTarget(c.position, 0.25f, v3f{1, .75, .1} * 0.3333f);
-			//lightsToDraw.push_back(createLight(v3f{1, .75, .1}, c.position, 2, (v2f)window.clientSize));
-		}
+				coinTiles[i] = createTile(c.position, uvs.uv0, uvs.uv1, uvs.uvMix, ATLAS_ENTRY_SIZE, V2f(0.5f));
+				coinTargets[i] = createRaycastTarget(c.position, 0.25f, v3f{1, .75, .1} * 0.3333f);
+				//lightsToDraw.push_back(createLight(v3f{1, .75, .1}, c.position, 2, (v2f)window.clientSize));
+			});
 
-		for (auto &bot : bots) {
-			pushTile(bot.position, offsetAtlasTile(3, 7), ATLAS_ENTRY_SIZE, V2f(bot.isBoss ? 2.0f : 1.0f));
-			//{bot.position, playerR, {}};
-		}
+			for (auto &bot : bots) {
+				pushTile(bot.position, offsetAtlasTile(3, 7), ATLAS_ENTRY_SIZE, V2f(bot.isBoss ? 2.0f : 1.0f));
+				//{bot.position, playerR, {}};
+			}
 
-		pushTile(playerP, offsetAtlasTile(3, 7), ATLAS_ENTRY_SIZE);
-		// player light
-		pushRaycastTarget(playerP, playerR, V3f(0.5f));
-		if (hasUltimateAttack()) {
-			auto uvs = getFrameUvs(scaledTime, 8, 8, {0, 3}, 1);
-			pushTile(playerP, uvs.uv0, uvs.uv1, uvs.uvMix, ATLAS_ENTRY_SIZE, V2f(1 + auraSize), scaledTime * pi, V4f(V3f(1), auraSize));
-		}
+			pushTile(playerP, offsetAtlasTile(3, 7), ATLAS_ENTRY_SIZE);
+			// player light
+			pushRaycastTarget(playerP, playerR, V3f(0.5f));
+			if (hasUltimateAttack()) {
+				auto uvs = getFrameUvs(scaledTime, 8, 8, {0, 3}, 1);
+				pushTile(playerP, uvs.uv0, uvs.uv1, uvs.uvMix, ATLAS_ENTRY_SIZE, V2f(1 + auraSize), scaledTime * pi, V4f(V3f(1), auraSize));
+			}
 		
-		for (auto &b : bullets) {
-			u32 frame = (u32)(b.remainingLifetime * 12) % 4;
-			v2u framePos{frame % 2, frame / 2};
-			pushTile(b.position, offsetAtlasTile(0, 7) + (v2f)framePos * ATLAS_ENTRY_SIZE * 0.5f, ATLAS_ENTRY_SIZE * 0.5f, V2f(0.5f), b.rotation);
-			v3f color = 0.5f * v3f{.4, .5, 1};
-			pushLight(color, b.position, 1, (v2f)window.clientSize);
-			pushRaycastTarget(b.position, 0.25f, color);
-		}
-		for (auto &e : explosions) {
-			f32 t = e.remainingLifeTime / e.maxLifeTime;
+			auto bulletTiles = appendSlots(tilesToDraw, bullets.size());
+			auto bulletLights = appendSlots(lightsToDraw, bullets.size());
+			auto bulletTargets = appendSlots(allRaycastTargets, bullets.size());
+			parallelFor((u32)bullets.size(), [&](u32 i) {
+				auto &b = bullets[i];
+				u32 frame = (u32)(b.remainingLifetime * 12) % 4;
+				v2u framePos{frame % 2, frame / 2};
+				bulletTiles[i] = createTile(b.position, offsetAtlasTile(0, 7) + (v2f)framePos * ATLAS_ENTRY_SIZE * 0.5f, ATLAS_ENTRY_SIZE * 0.5f, V2f(0.5f), b.rotation);
+				v3f color = 0.5f * v3f{.4, .5, 1};
+				bulletLights[i] = createLight(color, b.position, 1, (v2f)window.clientSize);
+				bulletTargets[i] = createRaycastTarget(b.position, 0.25f, color);
+			});
+		
+			auto explosionTiles = appendSlots(tilesToDraw, explosions.size());
+			auto explosionLights = appendSlots(lightsToDraw, explosions.size());
+			auto explosionTargets = appendSlots(allRaycastTargets, explosions.size());
+			parallelFor((u32)explosions.size(), [&](u32 i) {
+				auto &e = explosions[i];
+				f32 t = e.remainingLifeTime / e.maxLifeTime;
+
+				auto uvs = getFrameUvs(1 - t, 8, 8, {0, 2}, 1, false);
+
+				explosionTiles[i] = createTile(e.position, uvs.uv0, uvs.uv1, uvs.uvMix, ATLAS_ENTRY_SIZE, V2f(map(t, 0, 1, 0.75f, 1.5f)), t * 2 + e.rotationOffset);
+				v3f color = 0.5f * v3f{1, .5, .1};
+				explosionTargets[i] = createRaycastTarget(e.position, max(0.0f, t - 0.8f) * 5.0f, color * 5.0f);
+				explosionLights[i] = createLight(color * t * 3, e.position, 3, (v2f)window.clientSize);
+			});
+
+			// lightsToDraw.push_back(createLight(V3f(1), playerP, 7, (v2f)window.clientSize));
+		
+			// safe zone
+			v2f safeZonePos = {CHUNK_WIDTH/2-0.5f, 1.5f};
+			v3f safeZoneColor = 0.5f * v3f{0.3f, 1.0f, 0.6f};
+			if (shopIsAvailable) {
+				pushRaycastTarget(safeZonePos, 1, safeZoneColor);
+				pushLight(safeZoneColor, safeZonePos, 5, (v2f)window.clientSize);
+			}
+			pushTile(safeZonePos - v2f{0, 1.5f}, offsetAtlasTile(6, 4), ATLAS_ENTRY_SIZE * v2f{2, 1}, {2, 1}, pi * 0.1f);
+		};
 
-			auto uvs = getFrameUvs(1 - t, 8, 8, {0, 2}, 1, false);
+		bool doLight = !debugSun;
+		if (skipLightUpdateFrame)
+			doLight &= (bool)(time.frameCount & 1);
 
-			pushTile(e.position, uvs.uv0, uvs.uv1, uvs.uvMix, ATLAS_ENTRY_SIZE, V2f(map(t, 0, 1, 0.75f, 1.5f)), t * 2 + e.rotationOffset);
-			v3f color = 0.5f * v3f{1, .5, .1};
-			pushRaycastTarget(e.position, max(0.0f, t - 0.8f) * 5.0f, color * 5.0f);
-			pushLight(color * t * 3, e.position, 3, (v2f)window.clientSize);
-		}
+		auto updateLight = [&] {
+			lightAtlas.move(floor(playerP + 1.0f));
+
+			PerfTimer timer;
+			bool swapChecker = (skipLightUpdateFrame ? time.frameCount / 2 : time.frameCount) & 1;
+			lightAtlas.update(enableCheckerboard, swapChecker, scaledDelta, previousRaycastTargets);
+			debugProfile.raycastMS = lerp(debugProfile.raycastMS, timer.getMilliseconds(), time.delta);
+		};
+		auto buildDebugLines = [&] {
+			if (debugDrawRaycastTargets) {
+				for (auto &t : allRaycastTargets) {
+					pushDebugBox(t.boxMin, t.boxMax, V4f(t.color, 1));
+				}
+			}
+		};
+
+		ArenaList<Label> labels;
+		labels.reserve(8);
+
+		ArenaList<Tile> solidTiles;
+		solidTiles.reserve(16);
+
+		ArenaList<Tile> uiTiles;
+		uiTiles.reserve(16);
+
+		// NOTE: cursor visibility belongs to the window thread, so the ui stage only requests it
+		bool resumeRequested = false;
+		// NOTE: purchases change state the draw lists are built from, so they are applied after the frame graph
+		Upgrade *purchaseRequested = 0;
+		// NOTE: sound mixing reads the volume in parallel with the ui, so a drag is applied after the frame graph too
+		f32 requestedVolume = masterVolume;
+
+		// NOTE: merge pass uses last frame's ui alphas
+		v4f mergeParams = {menuAlpha, deathScreenAlpha};
+
+		auto buildUi = [&] {
+			f32 uiAnimationDelta = time.delta * 4;
+
+			uiAlpha = moveTowards(uiAlpha, (f32)(currentState != State::menu && currentState != State::death), uiAnimationDelta);
+			deathScreenAlpha = moveTowards(deathScreenAlpha, (f32)(currentState == State::death), uiAnimationDelta);
+			menuAlpha = moveTowards(menuAlpha, (f32)(currentState == State::menu), uiAnimationDelta);
+			pauseAlpha = moveTowards(pauseAlpha, (f32)(currentState == State::pause), uiAnimationDelta);
+			shopHintAlpha = moveTowards(shopHintAlpha, (f32)shopIsAvailable, uiAnimationDelta);
+			shopUiAlpha = moveTowards(shopUiAlpha, (f32)(shopIsAvailable && isPlayerInShop && currentState == State::game), uiAnimationDelta);
+		
+			if (shopHintAlpha > 0 && !isPlayerInShop && shopIsAvailable) {
+				labels.push_back({V2f(8, 256), " ", V4f(1,1,1,shopHintAlpha)});
+			}
+		
+		
+			auto rect = [&](v2f pos, v2f size, v4f color) {
+				pos.y = window.clientSize.y - pos.y - size.y;
+				pushTile(solidTiles, pos + size * 0.5f, {}, {}, size, 0, color);
+			};
+			auto contains = [](auto pos, auto size, auto mp) {
+				return inBounds(mp, boxMinDim(pos, size));
+			};
+			if (shopUiAlpha > 0) {
+				showPurchaseFailTime -= time.delta;
+
+				v4f uiColor = V4f(V3f(0.0f), shopUiAlpha * 0.5f);
+			
+				auto button = [&](v2f pos, v2f size, u32 index, auto &&text, bool &hovering) {
+					v2f rectPos = pos;
+					rectPos.y = window.clientSize.y - rectPos.y - size.y;
+					hovering = contains(rectPos, size, (v2f)mousePos);
+					rect(pos, size, hovering ? V4f(V3f(0.5f), uiColor.w) : uiColor);
+					labels.push_back({pos + 2, move(text), V4f(1, 1, 1, shopUiAlpha)});
+					return shopUiAlpha == 1 && hovering && input.mouseUp(0);
+				};
+			
+				v2f buyMenuPos = {(f32)((window.clientSize.x - 300) / 2), (f32)(window.clientSize.y / 2)};
+
+				StringView valueHeaderStr = " ";
+				//Label label;
+				//label.p = buyMenuPos - v2f{0, 26} - v2f{(f32)(valueHeaderStr.size()+1)*letterSize.x + 2, -2};
+				//label.color = V4f(1,1,1,shopUiAlpha);
+				//label.text = valueHeaderStr;
+				//labels.push_back(label);
+				labels.push_back({buyMenuPos - v2f{0, 26} - v2f{(f32)(valueHeaderStr.size()+1)*letterSize.x + 2, -2}, valueHeaderStr, V4f(1,1,1,shopUiAlpha)});
+				char const *upgradeStr = "";
+				labels.push_back({buyMenuPos - v2f{0, 26} + 2, upgradeStr, V4f(1, 1, 1, shopUiAlpha)});
+				for (u32 i = 0; i < upgrades.size(); ++i) {
+					auto &upgrade = upgrades[i];
+					v2f pos = buyMenuPos + v2f{0, (f32)(i * 26)};
+					bool hovering;
+					bool pressed = button(pos, {300, 26}, i, format("{}: ${}", upgrade.name, upgrade.cost), hovering);
+					if (hovering) {
+						labels.push_back({pos + v2f{312, 2}, upgrade.description, V4f(1,1,1,shopUiAlpha)});
+					}
+					auto currentValue = upgrade.currentValue(*this);
+					labels.push_back({pos - v2f{(f32)(currentValue.size()+1)*letterSize.x + 2, -2}, std::move(currentValue), V4f(1,1,1,shopUiAlpha)});
+					if (pressed) {
+						purchaseRequested = &upgrade;
+					}
+				}
+				if (showPurchaseFailTime > 0) {
+					labels.push_back({buyMenuPos + v2f{0, -32}, purchaseFailReason, V4f(1,1,1,shopUiAlpha)});
+				}
+			}
+		
+			if (pauseAlpha > 0) {
+				v4f menuColor = V4f(V3f(0.5f), pauseAlpha * 0.5f);
+
+				v2f menuPanelPos = (v2f)window.clientSize * 0.4f;
+				v2f menuPanelSize = (v2f)V2s(letterSize.x * 10, letterSize.y) + V2f(16);
+			
+				auto button = [&](v2f pos, v2f size, char const *text) {
+					v2f rectPos = pos;
+					rectPos.y = window.clientSize.y - rectPos.y - size.y;
+					bool c = contains(rectPos, size, (v2f)mousePos);
+					rect(pos, size, c ? V4f(1, 1, 1, menuColor.w) : menuColor);
+					labels.push_back({pos + 4, text, V4f(1, 1, 1, pauseAlpha)});
+					return c && input.mouseUp(0);
+				};
+
+				rect(menuPanelPos, menuPanelSize, menuColor);
+				if (button(menuPanelPos + 4, (v2f)V2s(letterSize.x * 10, letterSize.y) + V2f(8), "")) {
+					resumeRequested = true;
+				}
+			}
+
+			if (uiAlpha > 0) {
+				auto part = [&](s32 offset, v2f uv0, v2f uv1, f32 uvMix, f32 uvScale, f32 scale, f32 rotation, char const *fmt, auto param) {
+					v2f pos = {
+						(f32)(window.clientSize.x / 2 + offset),
+						(f32)(window.clientSize.y - 32 - letterSize.y) 
+					};
+					labels.push_back({pos, format(fmt, param), V4f(1,1,1,uiAlpha)});
+
+					pos.y += 8 + (letterSize.y - 32) * 0.5f;
+					pos.y = window.clientSize.y - pos.y;
 
-		// lightsToDraw.push_back(createLight(V3f(1), playerP, 7, (v2f)window.clientSize));
+					pos.x -= 16;
+					pushTile(uiTiles, pos, uv0, uv1, uvMix, ATLAS_ENTRY_SIZE * uvScale, V2f(32 * scale), rotation, V4f(1,1,1,uiAlpha));
+				};
+				auto ultimateUvs = getFrameUvs(scaledTime, 8, 8, {0, 3}, 1);
+
+				part(-200, offsetAtlasTile(1, 7), {}, 0, 1, 1,    0,               "{}%", playerHealth);
+				part(-100, ultimateUvs.uv0, ultimateUvs.uv1, ultimateUvs.uvMix, 1, 1.5f, scaledTime * pi, "{}%", ultimateAttackPercent);
+				part(   0, offsetAtlasTile(4, 4), {}, 0, 1, 1,    -pi / 6,         "{}",   coinsInWallet);
+				part( 100, offsetAtlasTile(5, 7), {}, 0, 1, 1,    0,               "{}",   botsKilled);
+				part( 200, offsetAtlasTile(6, 7), {}, 0, 1, 1,    0,               "{}",   currentWave);
+				if (showNoobText) {
+					auto noob = [&](v2f offset, char const *string) {
+						v2f pos = {
+							(f32)((window.clientSize.x - strlen(string) * letterSize.x) / 2 + offset.x),
+							(f32)(window.clientSize.y - 90 + offset.y * letterSize.y)
+						};
+						labels.push_back({pos, string, V4f(1,1,1,uiAlpha)});
+					};
+					noob({-200, 0}, "");
+					noob({-100,-1}, "()");
+					noob({   0, 0}, "");
+					noob({ 100,-1}, "");
+					noob({ 200, 0}, "");
+				}
+			}
+
+			if (menuAlpha > 0) {
+				labels.push_back({(v2f)window.clientSize * 0.4f, " 'Enter'  ", V4f(1,1,1,menuAlpha)});
+			}
+
+			if (deathScreenAlpha > 0) {
+				labels.push_back({(v2f)window.clientSize * 0.4f, format(": {}\n 'Enter'  ", botsKilled), V4f(1,1,1,deathScreenAlpha)});
+			}
 		
-		// safe zone
-		v2f safeZonePos = {CHUNK_WIDTH/2-0.5f, 1.5f};
-		v3f safeZoneColor = 0.5f * v3f{0.3f, 1.0f, 0.6f};
-		if (shopIsAvailable) {
-			pushRaycastTarget(safeZonePos, 1, safeZoneColor);
-			pushLight(safeZoneColor, safeZonePos, 5, (v2f)window.clientSize);
+			f32 volumeBarOpacity = max(menuAlpha, pauseAlpha);
+
+			if (volumeBarOpacity > 0) {
+				pushTile(uiTiles, (v2f)V2u(32, window.clientSize.y - 32), offsetAtlasTile(7, 7), ATLAS_ENTRY_SIZE, V2f(32), 0, V4f(1,1,1,volumeBarOpacity));
+
+				v2f volumeBarPos = {64, 24};
+				v2f volumeBarSize = {128, 16}; 
+				rect(volumeBarPos, volumeBarSize, V4f(V3f(0.5f), 0.5f * volumeBarOpacity));
+
+				bool containsVolume = contains(v2f{volumeBarPos.x, (f32)window.clientSize.y-volumeBarPos.y-volumeBarSize.y}, volumeBarSize, (v2f)mousePos);
+				rect({lerp(volumeBarPos.x, volumeBarPos.x+volumeBarSize.x-volumeBarSize.y, masterVolume), 24}, {volumeBarSize.y, volumeBarSize.y}, V4f(containsVolume ? V3f(1) : V3f(0.5f), 0.5f * volumeBarOpacity));
+
+				static bool draggingVolume = false;
+				if (containsVolume) {
+					if (input.mouseDown(0)) {
+						draggingVolume = true;
+					}
+				}
+				if (input.mouseUp(0)) {
+					draggingVolume = false;
+				}
+				if (draggingVolume) {
+					requestedVolume = clamp((f32)(mousePos.x - (volumeBarPos.x + volumeBarSize.y / 2)) / (volumeBarSize.x - volumeBarSize.y), 0, 1);
+				}
+			}
+	#if 0
+			labels.push_back({V2f(8), R"(
+
+	 !"#$%&'()*+,-./
+	0123456789:;<=>?
+	@ABCDEFGHIJKLMNO
+	PQRSTUVWXYZ[\]^_
+	`abcdefghijklmno
+	pqrstuvwxyz{|}~
+
+
+	        
+	        
+	
+	
+	
+	)"});
+	#endif
+		};
+
+		auto mixSounds = [&] {
+			soundMutex.lock();
+			for (auto sound : shotSounds) {
+				sound.volume /= shotSounds.size();
+				playingSounds.push_back(sound);
+			}
+			for (auto sound : explosionSounds) {
+				sound.volume /= explosionSounds.size();
+				playingSounds.push_back(sound);
+			}
+			for (auto sound : coinSounds) {
+				sound.volume /= coinSounds.size();
+				playingSounds.push_back(sound);
+			}
+			for (auto sound = playingSounds.begin(); sound != playingSounds.end();) {
+				if (!sound->looping && sound->cursor >= sound->buffer->sampleCount) {
+					playingSounds.erase(sound);
+					continue;
+				}
+				++sound;
+			}
+			if (playingMusic.cursor >= playingMusic.buffer->sampleCount) {
+				playNextMusic();
+			}
+			for (auto &sound : playingSounds) {
+				v2f volume = V2f(1);
+				v2f d = normalize(sound.position - cameraP, {0, 1});
+				if (d.x > 0) {
+					volume.x -= d.x;
+				} else {
+					volume.y += d.x;
+				}
+				f32 dist = distanceSqr(sound.position, cameraP);
+				volume = lerp(volume, V2f(1.0f), 1.0f / (dist * 0.1f + 1.0f));
+				volume *= 1.0f / (dist * 0.02f + 1.0f);
+
+				volume = lerp(volume, V2f(1.0f), sound.flatness);
+
+				volume *= sound.volume * masterVolume;
+
+				memcpy(sound.channelVolume, &volume, sizeof(sound.channelVolume));
+			}
+			soundMutex.unlock();
+		};
+
+		JobGraph frameGraph;
+		auto drawListsJob = frameGraph.add(buildDrawLists);
+		if (doLight) {
+			// NOTE: lights lag a frame behind the targets, in exchange the atlas runs alongside the draw lists
+			frameGraph.add(updateLight);
+			frameGraph.add(buildDebugLines, {drawListsJob});
+		}
+		frameGraph.add(buildUi);
+		frameGraph.add(mixSounds);
+
+		PerfTimer frameGraphTimer;
+		if (debugSerialFrameGraph) {
+			frameGraph.runSerial();
+		} else {
+			frameGraph.run();
+		}
+		f32 &frameGraphMS = debugSerialFrameGraph ? debugProfile.serialFrameGraphMS : debugProfile.frameGraphMS;
+		frameGraphMS = lerp(frameGraphMS, frameGraphTimer.getMilliseconds(), time.delta);
+
+		if (resumeRequested && currentState == State::pause) {
+			setCursorVisibility(false);
+			currentState = State::game;
+		}
+		if (requestedVolume != masterVolume) {
+			// NOTE: music is mixed on the audio thread under the same lock
+			soundMutex.lock();
+			masterVolume = requestedVolume;
+			soundMutex.unlock();
+		}
+		if (purchaseRequested) {
+			auto &upgrade = *purchaseRequested;
+			if (upgrade.extraCheck(*this, purchaseFailReason)) {
+				if (coinsInWallet >= upgrade.cost) {
+					coinsInWallet -= upgrade.cost;
+					upgrade.purchaseAction(*this, upgrade);
+				} else {
+					purchaseFailReason = "  !";
+					showPurchaseFailTime = 1;
+				}
+			} else {
+				showPurchaseFailTime = 1;
+			}
 		}
-		pushTile(safeZonePos - v2f{0, 1.5f}, offsetAtlasTile(6, 4), ATLAS_ENTRY_SIZE * v2f{2, 1}, {2, 1}, pi * 0.1f);
 
 		renderer.updateBuffer(tilesBuffer, tilesToDraw.data(), (u32)tilesToDraw.size() * sizeof(tilesToDraw[0]));
 		renderer.updateBuffer(lightsBuffer, lightsToDraw.data(), (u32)lightsToDraw.size() * sizeof(lightsToDraw[0]));
@@ -1943,24 +2383,8 @@ struct Game {
 			if (lightAtlas.move(floor(playerP + 1.0f))) {
 				makeLightAtlasWhite();
 			}
-		} else {
-			bool doLight = true;
-			if (skipLightUpdateFrame)
-				doLight = time.frameCount & 1;
-			if (doLight) {
-				lightAtlas.move(floor(playerP + 1.0f));
-				if (debugDrawRaycastTargets) {
-					for (auto &t : allRaycastTargets) {
-						pushDebugBox(t.boxMin, t.boxMax, V4f(t.color, 1));
-					}
-				}
-
-				PerfTimer timer;
-				bool swapChecker = (skipLightUpdateFrame ? time.frameCount / 2 : time.frameCount) & 1;
-				lightAtlas.update(enableCheckerboard, swapChecker, scaledDelta, allRaycastTargets);
-				debugProfile.raycastMS = lerp(debugProfile.raycastMS, timer.getMilliseconds(), time.delta);
-				generateLightAtlasTextures();
-			}
+		} else if (doLight) {
+			generateLightAtlasTextures();
 		}
 
 		m4 worldMatrix = m4::scaling(camZoom) * m4::scaling((f32)window.clientSize.y / window.clientSize.x, 1, 1) *
@@ -1989,7 +2413,7 @@ struct Game {
 					   m4::scaling(voxScale / (v2f)lightAtlas.size / camZoom * 2, 1);
 
 		renderer.setMatrix(0, voxMatrix);
-		renderer.setV4f(0, {menuAlpha, deathScreenAlpha});
+		renderer.setV4f(0, mergeParams);
 		renderer.bindRenderTarget({0});
 		renderer.bindTextures(gBuffers, Stage::ps, 0);
 		renderer.bindTexture(basicLightsRt, Stage::ps, 2);
@@ -2032,203 +2456,6 @@ struct Game {
 
 		renderer.setTopology(Topology::TriangleList);
 
-		tilesToDraw.clear();
-		
-		UnorderedList<Label, TempAllocator> labels;
-		labels.reserve(8);
-
-		f32 uiAnimationDelta = time.delta * 4;
-
-		uiAlpha = moveTowards(uiAlpha, (f32)(currentState != State::menu && currentState != State::death), uiAnimationDelta);
-		deathScreenAlpha = moveTowards(deathScreenAlpha, (f32)(currentState == State::death), uiAnimationDelta);
-		menuAlpha = moveTowards(menuAlpha, (f32)(currentState == State::menu), uiAnimationDelta);
-		pauseAlpha = moveTowards(pauseAlpha, (f32)(currentState == State::pause), uiAnimationDelta);
-		shopHintAlpha = moveTowards(shopHintAlpha, (f32)shopIsAvailable, uiAnimationDelta);
-		shopUiAlpha = moveTowards(shopUiAlpha, (f32)(shopIsAvailable && isPlayerInShop && currentState == State::game), uiAnimationDelta);
-		
-		if (shopHintAlpha > 0 && !isPlayerInShop && shopIsAvailable) {
-			labels.push_back({V2f(8, 256), " ", V4f(1,1,1,shopHintAlpha)});
-		}
-		
-		List<Tile, TempAllocator> solidTiles;
-		solidTiles.reserve(16);
-
-		List<Tile, TempAllocator> uiTiles;
-		uiTiles.reserve(16);
-		
-		auto rect = [&](v2f pos, v2f size, v4f color) {
-			pos.y = window.clientSize.y - pos.y - size.y;
-			pushTile(solidTiles, pos + size * 0.5f, {}, {}, size, 0, color);
-		};
-		auto contains = [](auto pos, auto size, auto mp) {
-			return inBounds(mp, boxMinDim(pos, size));
-		};
-		if (shopUiAlpha > 0) {
-			showPurchaseFailTime -= time.delta;
-
-			v4f uiColor = V4f(V3f(0.0f), shopUiAlpha * 0.5f);
-			
-			auto button = [&](v2f pos, v2f size, u32 index, auto &&text, bool &hovering) {
-				v2f rectPos = pos;
-				rectPos.y = window.clientSize.y - rectPos.y - size.y;
-				hovering = contains(rectPos, size, (v2f)mousePos);
-				rect(pos, size, hovering ? V4f(V3f(0.5f), uiColor.w) : uiColor);
-				labels.push_back({pos + 2, move(text), V4f(1, 1, 1, shopUiAlpha)});
-				return shopUiAlpha == 1 && hovering && input.mouseUp(0);
-			};
-			
-			v2f buyMenuPos = {(f32)((window.clientSize.x - 300) / 2), (f32)(window.clientSize.y / 2)};
-
-			StringView valueHeaderStr = " ";
-			//Label label;
-			//label.p = buyMenuPos - v2f{0, 26} - v2f{(f32)(valueHeaderStr.size()+1)*letterSize.x + 2, -2};
-			//label.color = V4f(1,1,1,shopUiAlpha);
-			//label.text = valueHeaderStr;
-			//labels.push_back(label);
-			labels.push_back({buyMenuPos - v2f{0, 26} - v2f{(f32)(valueHeaderStr.size()+1)*letterSize.x + 2, -2}, valueHeaderStr, V4f(1,1,1,shopUiAlpha)});
-			char const *upgradeStr = "";
-			labels.push_back({buyMenuPos - v2f{0, 26} + 2, upgradeStr, V4f(1, 1, 1, shopUiAlpha)});
-			for (u32 i = 0; i < upgrades.size(); ++i) {
-				auto &upgrade = upgrades[i];
-				v2f pos = buyMenuPos + v2f{0, (f32)(i * 26)};
-				bool hovering;
-				bool pressed = button(pos, {300, 26}, i, format("{}: ${}", upgrade.name, upgrade.cost), hovering);
-				if (hovering) {
-					labels.push_back({pos + v2f{312, 2}, upgrade.description, V4f(1,1,1,shopUiAlpha)});
-				}
-				auto currentValue = upgrade.currentValue(*this);
-				labels.push_back({pos - v2f{(f32)(currentValue.size()+1)*letterSize.x + 2, -2}, std::move(currentValue), V4f(1,1,1,shopUiAlpha)});
-				if (pressed) {
-					if (upgrade.extraCheck(*this, purchaseFailReason)) {
-						if (coinsInWallet >= upgrade.cost) {
-							coinsInWallet -= upgrade.cost;
-							upgrade.purchaseAction(*this, upgrade);
-						} else {
-							purchaseFailReason = "  !";
-							showPurchaseFailTime = 1;
-						}
-					} else {
-						showPurchaseFailTime = 1;
-					} 
-				}
-			}
-			if (showPurchaseFailTime > 0) {
-				labels.push_back({buyMenuPos + v2f{0, -32}, purchaseFailReason, V4f(1,1,1,shopUiAlpha)});
-			}
-		}
-		
-		if (pauseAlpha > 0) {
-			v4f menuColor = V4f(V3f(0.5f), pauseAlpha * 0.5f);
-
-			v2f menuPanelPos = (v2f)window.clientSize * 0.4f;
-			v2f menuPanelSize = (v2f)V2s(letterSize.x * 10, letterSize.y) + V2f(16);
-			
-			auto button = [&](v2f pos, v2f size, char const *text) {
-				v2f rectPos = pos;
-				rectPos.y = window.clientSize.y - rectPos.y - size.y;
-				bool c = contains(rectPos, size, (v2f)mousePos);
-				rect(pos, size, c ? V4f(1, 1, 1, menuColor.w) : menuColor);
-				labels.push_back({pos + 4, text, V4f(1, 1, 1, pauseAlpha)});
-				return c && input.mouseUp(0);
-			};
-
-			rect(menuPanelPos, menuPanelSize, menuColor);
-			if (button(menuPanelPos + 4, (v2f)V2s(letterSize.x * 10, letterSize.y) + V2f(8), "")) {
-				if (currentState == State::pause) {
-					setCursorVisibility(false);
-					currentState = State::game;
-				}
-			}
-		}
-
-		if (uiAlpha > 0) {
-			auto part = [&](s32 offset, v2f uv0, v2f uv1, f32 uvMix, f32 uvScale, f32 scale, f32 rotation, char const *fmt, auto param) {
-				v2f pos = {
-					(f32)(window.clientSize.x / 2 + offset),
-					(f32)(window.clientSize.y - 32 - letterSize.y) 
-				};
-				labels.push_back({pos, format(fmt, param), V4f(1,1,1,uiAlpha)});
-
-				pos.y += 8 + (letterSize.y - 32) * 0.5f;
-				pos.y = window.clientSize.y - pos.y;
-
-				pos.x -= 16;
-				pushTile(uiTiles, pos, uv0, uv1, uvMix, ATLAS_ENTRY_SIZE * uvScale, V2f(32 * scale), rotation, V4f(1,1,1,uiAlpha));
-			};
-			auto ultimateUvs = getFrameUvs(scaledTime, 8, 8, {0, 3}, 1);
-
-			part(-200, offsetAtlasTile(1, 7), {}, 0, 1, 1,    0,               "{}%", playerHealth);
-			part(-100, ultimateUvs.uv0, ultimateUvs.uv1, ultimateUvs.uvMix, 1, 1.5f, scaledTime * pi, "{}%", ultimateAttackPercent);
-			part(   0, offsetAtlasTile(4, 4), {}, 0, 1, 1,    -pi / 6,         "{}",   coinsInWallet);
-			part( 100, offsetAtlasTile(5, 7), {}, 0, 1, 1,    0,               "{}",   botsKilled);
-			part( 200, offsetAtlasTile(6, 7), {}, 0, 1, 1,    0,               "{}",   currentWave);
-			if (showNoobText) {
-				auto noob = [&](v2f offset, char const *string) {
-					v2f pos = {
-						(f32)((window.clientSize.x - strlen(string) * letterSize.x) / 2 + offset.x),
-						(f32)(window.clientSize.y - 90 + offset.y * letterSize.y)
-					};
-					labels.push_back({pos, string, V4f(1,1,1,uiAlpha)});
-				};
-				noob({-200, 0}, "");
-				noob({-100,-1}, "()");
-				noob({   0, 0}, "");
-				noob({ 100,-1}, "");
-				noob({ 200, 0}, "");
-			}
-		}
-
-		if (menuAlpha > 0) {
-			labels.push_back({(v2f)window.clientSize * 0.4f, " 'Enter'  ", V4f(1,1,1,menuAlpha)});
-		}
-
-		if (deathScreenAlpha > 0) {
-			labels.push_back({(v2f)window.clientSize * 0.4f, format(": {}\n 'Enter'  ", botsKilled), V4f(1,1,1,deathScreenAlpha)});
-		}
-		
-		f32 volumeBarOpacity = max(menuAlpha, pauseAlpha);
-
-		if (volumeBarOpacity > 0) {
-			pushTile(uiTiles, (v2f)V2u(32, window.clientSize.y - 32), offsetAtlasTile(7, 7), ATLAS_ENTRY_SIZE, V2f(32), 0, V4f(1,1,1,volumeBarOpacity));
-
-			v2f volumeBarPos = {64, 24};
-			v2f volumeBarSize = {128, 16}; 
-			rect(volumeBarPos, volumeBarSize, V4f(V3f(0.5f), 0.5f * volumeBarOpacity));
-
-			bool containsVolume = contains(v2f{volumeBarPos.x, (f32)window.clientSize.y-volumeBarPos.y-volumeBarSize.y}, volumeBarSize, (v2f)mousePos);
-			rect({lerp(volumeBarPos.x, volumeBarPos.x+volumeBarSize.x-volumeBarSize.y, masterVolume), 24}, {volumeBarSize.y, volumeBarSize.y}, V4f(containsVolume ? V3f(1) : V3f(0.5f), 0.5f * volumeBarOpacity));
-
-			static bool draggingVolume = false;
-			if (containsVolume) {
-				if (input.mouseDown(0)) {
-					draggingVolume = true;
-				}
-			}
-			if (input.mouseUp(0)) {
-				draggingVolume = false;
-			}
-			if (draggingVolume) {
-				masterVolume = clamp((f32)(mousePos.x - (volumeBarPos.x + volumeBarSize.y / 2)) / (volumeBarSize.x - volumeBarSize.y), 0, 1);
-			}
-		}
-#if 0
-		labels.push_back({V2f(8), R"(
-
- !"#$%&'()*+,-./
-0123456789:;<=>?
-@ABCDEFGHIJKLMNO
-PQRSTUVWXYZ[\]^_
-`abcdefghijklmno
-pqrstuvwxyz{|}~
-
-
-        
-        
-
-
-
-)"});
-#endif
 		renderer.updateBuffer(tilesBuffer, solidTiles.data(), (u32)solidTiles.size() * sizeof(solidTiles[0]));
 		renderer.setBlend(Blend::srcAlpha, Blend::invSrcAlpha, BlendOp::add);
 		renderer.setMatrix(0, m4::translation(-1, -1, 0) * m4::scaling(2.0f / (v2f)window.clientSize, 1));
@@ -2249,48 +2476,6 @@ pqrstuvwxyz{|}~
 		renderer.bindTexture(atlasAlbedo, Stage::ps, 0);
 		renderer.draw((u32)uiTiles.size() * 6);
 
-		soundMutex.lock();
-		for (auto sound : shotSounds) {
-			sound.volume /= shotSounds.size();
-			playingSounds.push_back(sound);
-		}
-		for (auto sound : explosionSounds) {
-			sound.volume /= explosionSounds.size();
-			playingSounds.push_back(sound);
-		}
-		for (auto sound : coinSounds) {
-			sound.volume /= coinSounds.size();
-			playingSounds.push_back(sound);
-		}
-		for (auto sound = playingSounds.begin(); sound != playingSounds.end();) {
-			if (!sound->looping && sound->cursor >= sound->buffer->sampleCount) {
-				playingSounds.erase(sound);
-				continue;
-			}
-			++sound;
-		}
-		if (playingMusic.cursor >= playingMusic.buffer->sampleCount) {
-			playNextMusic();
-		}
-		for (auto &sound : playingSounds) {
-			v2f volume = V2f(1);
-			v2f d = normalize(sound.position - cameraP, {0, 1});
-			if (d.x > 0) {
-				volume.x -= d.x;
-			} else {
-				volume.y += d.x;
-			}
-			f32 dist = distanceSqr(sound.position, cameraP);
-			volume = lerp(volume, V2f(1.0f), 1.0f / (dist * 0.1f + 1.0f));
-			volume *= 1.0f / (dist * 0.02f + 1.0f);
-
-			volume = lerp(volume, V2f(1.0f), sound.flatness);
-
-			volume *= sound.volume * masterVolume;
-
-			memcpy(sound.channelVolume, &volume, sizeof(sound.channelVolume));
-		}
-		soundMutex.unlock();
 	}
 
 	void fillSoundBuffer(Audio &audio, s16 *subsample, u32 sampleCount) {
@@ -2329,6 +2514,7 @@ char const *getName() { return "dunger"; }
 
 static Profiler::Stats frameStats[256]{};
 static Profiler::Stats *currentFrameStats = frameStats;
+static StaticList<WorkerStats, CpuInfo::maxTopologyEntries> workerFrameStats[_countof(frameStats)]{};
 static ::Random random;
 static u32 sortIndex = 0;
 static bool showOnlyCurrentFrame = true;
@@ -2356,29 +2542,62 @@ void update(EngState &state, Window &window, Renderer &renderer, Input &input, T
 	getGame(state).update(window, renderer, input, time);
 }
 void debugUpdate(EngState &state, Window &window, Renderer &renderer, Input &input, Time &time, Profiler::Stats const &startStats, Profiler::Stats const &newFrameStats) {
+	// NOTE: labels and profiler strings are only needed until they are drawn at the end
+	TempScope tempScope;
 	if (input.keyDown(Key_f3)) {
 		state.forceReload = true;
 	}
 	auto &game = getGame(state);
 	*currentFrameStats = newFrameStats;
+	auto &currentWorkerStats = workerFrameStats[currentFrameStats - frameStats];
+	currentWorkerStats.clear();
+	for (auto &stats : getWorkerStats()) {
+		if (currentWorkerStats.size() == CpuInfo::maxTopologyEntries)
+			break;
+		currentWorkerStats.push_back(stats);
+	}
 	if (++currentFrameStats == std::end(frameStats)) {
 		currentFrameStats = frameStats;
 	}
 	if (input.keyDown(Key_f1)) {
 		game.debugProfile.mode = (u8)((game.debugProfile.mode + 1) % 4);
 	}
-	List<Label, TempAllocator> labels;
-	List<Rect, TempAllocator> rects;
+	ArenaList<Label> labels;
+	ArenaList<Rect> rects;
 	v2s mp = input.mousePosition;
 	if (game.debugProfile.mode == 1) {
 		static f32 smoothDelta = time.delta;
 		smoothDelta = lerp(smoothDelta, time.delta, 0.05f);
+
+		u32 tempCommitted = 0;
+		u32 tempPeak = 0;
+		u32 tempReclaimed = 0;
+		u32 frameCommitted = 0;
+		u32 grownInPlace = 0;
+		u32 stranded = 0;
+		for (auto &stats : getTempStorageStats()) {
+			tempCommitted += stats.committed;
+			tempReclaimed += stats.reclaimed;
+			frameCommitted += stats.frameCommitted;
+			grownInPlace += stats.grownInPlace;
+			stranded += stats.stranded;
+			tempPeak = max(tempPeak, stats.peak);
+		}
+		StringBuilder<TempAllocator> memoryTags;
+		for (u32 tag = 0; tag < (u32)MemoryTag::count; ++tag) {
+			auto stats = getMemoryTagStats((MemoryTag)tag);
+			if (stats.allocationCount)
+				memoryTags.append(format("\n  {}: {}, peak {}", toString((MemoryTag)tag), cvtBytes(stats.liveBytes), cvtBytes(stats.peakBytes)));
+		}
 		
 		labels.push_back({V2f(8), format(R"({}, {}, {} cores, L1: {}, L2: {}, L3: {}
 delta: {} ms ({} FPS)
-memory usage: {}
-temp usage: {}
+memory usage: {}{}
+temp usage: {}, {} committed, {} peak per thread, {} reclaimed by scopes
+frame usage: {}, {} committed
+list growth: {} kept in place, {} left behind
 {} raycasts, {} ms total, {} volumes tested
+frame graph: {} ms parallel, {} ms serial{}
 draw calls: {})", 
 				toString(cpuInfo.vendor), 
 				cpuInfo.brand, 
@@ -2387,9 +2606,14 @@ draw calls: {})",
 				cvtBytes(cpuInfo.totalCacheSize(2)), 
 				cvtBytes(cpuInfo.totalCacheSize(3)),
 				smoothDelta * 1000, 1.0f / smoothDelta,
-				cvtBytes(getMemoryUsage()),
+				cvtBytes(getMemoryUsage()), memoryTags.get(),
 				cvtBytes(getTempMemoryUsage()),
-				game.lightAtlas.totalRaysCast, game.debugProfile.raycastMS, game.lightAtlas.totalVolumeChecks, renderer.getDrawCount())});
+				cvtBytes(tempCommitted), cvtBytes(tempPeak), cvtBytes(tempReclaimed),
+				cvtBytes(getFrameMemoryUsage()), cvtBytes(frameCommitted),
+				cvtBytes(grownInPlace), cvtBytes(stranded),
+				game.lightAtlas.totalRaysCast, game.debugProfile.raycastMS, game.lightAtlas.totalVolumeChecks, 
+				game.debugProfile.frameGraphMS, game.debugProfile.serialFrameGraphMS, game.debugSerialFrameGraph ? " (serial)" : "",
+				renderer.getDrawCount())});
 		
 		StringBuilder<TempAllocator> builder;
 		builder.append("debugValues:\n");
@@ -2408,27 +2632,34 @@ draw calls: {})",
 					INVALID_CODE_PATH();
 			}
 		}
+		
+		auto idleStats = getWorkerIdleStats();
+		builder.append(format("\nworkers: {} parks, {} spin hits, spin {} us\nwake latency (us):\n", idleStats.parks, idleStats.spinHits, getWorkerSpinMicroseconds()));
+		for (u32 i = 0; i < WorkerIdleStats::latencyBucketCount; ++i) {
+			builder.append(format("<{}: {}\n", 1 << i, idleStats.wakeLatency[i]));
+		}
 		labels.push_back({v2f{1024, 8}, builder.get()});
 #if 1
 		audioMutex.lock();
 		
-		game.debugLines.clear();
+		ArenaList<Game::DebugLine> audioLines;
+		audioLines.reserve(_countof(audioGraph));
 		for (s32 i = 1; i < _countof(audioGraph); ++i) {
 			s32 x0 = 15 + i;
 			s32 x1 = 16 + i;
 			s32 y0 = (250 + audioGraph[frac(i + (s32)(audioGraphCursor - audioGraph) - 1, _countof(audioGraph))] * 250 / max<s16>());
 			s32 y1 = (250 + audioGraph[frac(i + (s32)(audioGraphCursor - audioGraph) - 0, _countof(audioGraph))] * 250 / max<s16>());
-			game.pushDebugLine((v2f)v2s{x0,y0}, (v2f)v2s{x1,y1}, V4f(1));
+			audioLines.push_back({(v2f)v2s{x0,y0}, (v2f)v2s{x1,y1}, V4f(1)});
 		}
 		audioMutex.unlock();
 
-		renderer.updateBuffer(game.debugLineBuffer, game.debugLines.data(), (u32)game.debugLines.size() * sizeof(game.debugLines[0]));
+		renderer.updateBuffer(game.debugLineBuffer, audioLines.data(), (u32)audioLines.size() * sizeof(audioLines[0]));
 		renderer.bindBuffer(game.debugLineBuffer, Stage::vs, 0);
 
 		renderer.setTopology(Topology::LineList);
 		renderer.setMatrix(0, m4::translation(-1, -1, 0) * m4::scaling(2.0f / (v2f)window.clientSize, 1));
 		renderer.bindShader(game.lineShader);
-		renderer.draw((u32)game.debugLines.size() * 2);
+		renderer.draw((u32)audioLines.size() * 2);
 		renderer.setTopology(Topology::TriangleList);
 
 #else 
@@ -2577,7 +2808,7 @@ draw calls: {})",
 			}
 		}
 
-		std::sort(allEntries.begin(), allEntries.end(),
+		parallelSort(allEntries.begin(), allEntries.end(),
 					comparers[(sortIndex & 0xF) * 2 + (bool)(sortIndex & 0x10)]);
 
 		//Log::print("{}", totalThreadUs);
@@ -2627,6 +2858,39 @@ draw calls: {})",
 					pastDuration += duration;
 				}
 			}
+
+			// NOTE: one row per thread, every column is a frame split into busy (green), waiting (red) and idle (gray)
+			u32 threadCount = getWorkerThreadCount() + 1;
+			s32 rowHeight = min(24, 500 / (s32)threadCount);
+			for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex) {
+				s32 rowY = (s32)window.clientSize.y - 16 - 500 + (s32)threadIndex * rowHeight;
+				for (s32 statIndex = 0; statIndex < _countof(workerFrameStats); statIndex++) {
+					auto &frame = workerFrameStats[statIndex];
+					if (threadIndex >= frame.size())
+						continue;
+					auto &stats = frame[threadIndex];
+					f32 totalMS = stats.busyMS + stats.waitMS + stats.idleMS;
+					if (totalMS <= 0)
+						continue;
+
+					s32 x = 16 + (s32)_countof(frameStats) * 2 + 32 + statIndex * 2;
+					s32 busyHeight = (s32)(stats.busyMS / totalMS * (rowHeight - 2));
+					s32 waitHeight = (s32)(stats.waitMS / totalMS * (rowHeight - 2));
+					s32 idleHeight = rowHeight - 2 - busyHeight - waitHeight;
+					rects.push_back({{x, rowY}, {2, busyHeight}, V4f(0.3f, 0.9f, 0.3f, 1)});
+					rects.push_back({{x, rowY + busyHeight}, {2, waitHeight}, V4f(0.9f, 0.3f, 0.3f, 1)});
+					rects.push_back({{x, rowY + busyHeight + waitHeight}, {2, idleHeight}, V4f(0.3f, 0.3f, 0.3f, 1)});
+
+					v2s pos = {x, rowY};
+					v2s size = {2, rowHeight};
+					if (contains(pos, size, mp)) {
+						hovering = true;
+						labels.push_back({(v2f)mp, format("thread {}: {} jobs, {} stolen, max depth {}\nbusy {} ms, wait {} ms, idle {} ms", 
+														  threadIndex, stats.jobs, stats.steals, stats.maxQueueDepth, stats.busyMS, stats.waitMS, stats.idleMS)});
+					}
+				}
+			}
+
 			if (hovering != wasHovering) {
 				setCursorVisibility(hovering);
 			}
@@ -2661,6 +2925,16 @@ void fillSoundBuffer(EngState &state, Audio &audio, s16 *subsample, u32 subsampl
 	audioMutex.unlock();
 }
 
-void shutdown(EngState &state) { delete state.userData; }
+void shutdown(EngState &state) {
+	// NOTE: tracks that haven't started loading are dropped, only the ones in flight are waited for
+	getGame(state).musicCancellation.cancel();
+	for (auto &track : getGame(state).loadingMusic) {
+		track.wait();
+		// NOTE: nobody took these out with 'get', so their buffers are still ours
+		if (!track.cancelled())
+			freeSoundBuffer(track.get());
+	}
+	delete state.userData;
+}
 } // namespace GameApi
   //#include "../../src/game_default_interface.h"
\ No newline at end of file
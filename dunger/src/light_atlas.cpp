@@ -2,8 +2,6 @@
 #include "light_atlas.h"
 
 OPTIMIZE_EXPORT UPDATE_LIGHT_ATLAS(updateLightAtlas) {
-	Atomic<u32> totalRaysCast = 0;
-	Atomic<u32> totalVolumeChecks = 0;
 
 	constexpr s32xm sampleOffsetsx = []() {
 		if constexpr (LightAtlas::simdElementCount == 4)
@@ -25,13 +23,16 @@ OPTIMIZE_EXPORT UPDATE_LIGHT_ATLAS(updateLightAtlas) {
 
 #define RESTRICT_METHOD RESTRICT_ROW
 
-	auto cast = [&](s32 voxelY) {
+	auto cast = [&](s32 voxelY, LightCastStats &stats) {
 		PROFILE_SCOPE("raycast");
 
 		f32 maxRayLength = length((v2f)atlas.size);
 		
 #if RESTRICT_METHOD == RESTRICT_ROW
-		StaticList<LightTile, 1024> tilesToTest;
+		// NOTE: the list is given back when the row is done, so a thread casting many rows reuses the same memory
+		TempScope tempScope;
+		List<LightTile, TempAllocator> tilesToTest;
+		tilesToTest.reserve(allRaycastTargets.size());
 		v2f rayBoxRaduis = V2f(maxRayLength);
 		auto testRegion = boxMinMax(v2f{0, (f32)voxelY} - rayBoxRaduis, v2f{(f32)atlas.size.x, (f32)voxelY} + rayBoxRaduis);
 		for (auto const &tile : allRaycastTargets) {
@@ -110,8 +111,8 @@ OPTIMIZE_EXPORT UPDATE_LIGHT_ATLAS(updateLightAtlas) {
 						++raycasts;
 					}
 				}
-				totalVolumeChecks += (u32)tilesToTest.size();
-				totalRaysCast += raycasts * atlas.simdElementCount;
+				stats.volumeChecks += (u32)tilesToTest.size();
+				stats.raysCast += raycasts * atlas.simdElementCount;
 				((v3fxm *)vox)[sampleIndex] += hitColor * 10;
 			}
 			for (v3fxm &v : Span((v3fxm *)vox, (umm)sampleCountX)) {
@@ -146,8 +147,8 @@ OPTIMIZE_EXPORT UPDATE_LIGHT_ATLAS(updateLightAtlas) {
 						}
 					}
 				}
-				totalRaysCast += raycasts;
-				totalVolumeChecks += (u32)tilesToTest.size();
+				stats.raysCast += raycasts;
+				stats.volumeChecks += (u32)tilesToTest.size();
 				vox[i] += hitColor * 10; //(10000.0f - pow2(distanceSqr(rayBegin, point))) * 0.001f * hitColor;
 			}
 			v3f *dest = atlas.getVoxel(voxelY, voxelX);
@@ -159,19 +160,21 @@ OPTIMIZE_EXPORT UPDATE_LIGHT_ATLAS(updateLightAtlas) {
 #endif
 		}
 	};
+	LightCastStats stats{};
 	if (timeDelta) {
 		if (threaded) {
-			WorkQueue queue{};
-			for (s32 ySlice : Range((s32)atlas.size.y)) {
-				queue.push(cast, ySlice);
-			}
-			queue.completeAllWork();
+			parallelFor(atlas.size.y, [&](u32 voxelY) { cast((s32)voxelY, atlas.castStats.local()); });
+			atlas.castStats.forEach([&](LightCastStats &slot) {
+				stats.raysCast += slot.raysCast;
+				stats.volumeChecks += slot.volumeChecks;
+				slot = {};
+			});
 		} else {
 			for (s32 ySlice : Range((s32)atlas.size.y)) {
-				cast(ySlice);
+				cast(ySlice, stats);
 			}
 		}
 	}
-	atlas.totalRaysCast = totalRaysCast;
-	atlas.totalVolumeChecks = totalVolumeChecks;
+	atlas.totalRaysCast = stats.raysCast;
+	atlas.totalVolumeChecks = stats.volumeChecks;
 }
@@ -16,6 +16,10 @@ struct LightTile {
 	v2f boxMax;
 	v3f color;
 };
+struct LightCastStats {
+	u32 raysCast;
+	u32 volumeChecks;
+};
 struct LightAtlas {
 	static constexpr u32 simdElementCount = TL::simdElementCount<f32>;
 	static constexpr u32 maxSampleCount = 128;
@@ -25,6 +29,8 @@ struct LightAtlas {
 	v2f center{};
 	v2f oldCenter{};
 	v3f *voxels = 0;
+	// NOTE: every update walks all of it, on large pages the walk needs a few TLB entries instead of thousands
+	PageAllocation voxelPages{};
 	v2f *samplingCircle = 0;
 	u32 sampleCount;
 	f32 accumulationRate;
@@ -34,6 +40,8 @@ struct LightAtlas {
 	
 	u32 totalRaysCast;
 	u32 totalVolumeChecks;
+	// NOTE: sized by the worker count, so atlases must be created after the workers start, games are
+	PerThread<LightCastStats> castStats;
 
 	v3f *getVoxel(u32 y, u32 x) {
 		return voxels + (y * size.x + x) * sampleCount;
@@ -49,15 +57,16 @@ struct LightAtlas {
 
 	void resize(v2u newSize) {
 		size = newSize;
-		free(voxels);
+		freePages(MemoryTag::lightAtlas, voxelPages);
 		umm dataSize = probeSize() * size.x * size.y;
-		voxels = (v3f *)malloc(dataSize);
+		voxelPages = allocatePages(MemoryTag::lightAtlas, dataSize, true);
+		voxels = (v3f *)voxelPages.data;
 		memset(voxels, 0, dataSize);
 	}
 	void init(u32 newSampleCount, float newAccumulationRate) {
 		accumulationRate = newAccumulationRate;
 		sampleCount = newSampleCount;
-		samplingCircle = (v2f *)malloc(sampleCount * sizeof(samplingCircle[0]));
+		samplingCircle = (v2f *)allocateTagged(MemoryTag::lightAtlas, sampleCount * sizeof(samplingCircle[0]));
 		for (u32 i = 0; i < sampleCount; ++i) {
 			f32 angle = (f32)i / sampleCount * (pi * 2);
 			sincos(angle, samplingCircle[i].x, samplingCircle[i].y);
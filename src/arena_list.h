@@ -0,0 +1,96 @@
+#pragma once
+#include "common.h"
+#include <new>
+
+// Growable list in temp or frame memory. Arena allocators can't free, so a List that outgrows its buffer leaves the
+// old one behind until the reset. This one grows in place while its buffer is the last allocation in the thread's
+// arena, and only copies when something else was allocated after it. 'getTempStorageStats' counts both cases.
+// NOTE: the buffer lives as long as the allocator's memory, item destructors still run
+template <class T, class Allocator = TempAllocator>
+struct ArenaList {
+	ArenaList() = default;
+	ArenaList(ArenaList const &) = delete;
+	ArenaList &operator=(ArenaList const &) = delete;
+	ArenaList(ArenaList &&that) { *this = std::move(that); }
+	ArenaList &operator=(ArenaList &&that) {
+		if (this != &that) {
+			clear();
+			buffer = that.buffer;
+			count = that.count;
+			capacity = that.capacity;
+			that.buffer = 0;
+			that.count = 0;
+			that.capacity = 0;
+		}
+		return *this;
+	}
+	~ArenaList() { clear(); }
+
+	void reserve(umm newCapacity) {
+		if (newCapacity <= capacity)
+			return;
+		if (buffer && Allocator::extend(buffer, capacity * sizeof(T), newCapacity * sizeof(T))) {
+			capacity = newCapacity;
+			return;
+		}
+		T *newBuffer = (T *)Allocator::allocate(newCapacity * sizeof(T), alignof(T));
+		for (umm i = 0; i < count; ++i) {
+			new (newBuffer + i) T(std::move(buffer[i]));
+			buffer[i].~T();
+		}
+		buffer = newBuffer;
+		capacity = newCapacity;
+	}
+	void resize(umm newCount) {
+		reserve(newCount);
+		for (umm i = count; i < newCount; ++i)
+			new (buffer + i) T();
+		for (umm i = newCount; i < count; ++i)
+			buffer[i].~T();
+		count = newCount;
+	}
+	// Keeps the buffer, a cleared list refills without growing
+	void clear() {
+		for (umm i = 0; i < count; ++i)
+			buffer[i].~T();
+		count = 0;
+	}
+
+	T &push_back(T const &item) {
+		grow();
+		return *new (buffer + count++) T(item);
+	}
+	T &push_back(T &&item) {
+		grow();
+		return *new (buffer + count++) T(std::move(item));
+	}
+	void pop_back() {
+		ASSERT(count, "pop_back on an empty list");
+		buffer[--count].~T();
+	}
+
+	umm size() const { return count; }
+	bool empty() const { return count == 0; }
+	T *data() { return buffer; }
+	T const *data() const { return buffer; }
+	T *begin() { return buffer; }
+	T *end() { return buffer + count; }
+	T const *begin() const { return buffer; }
+	T const *end() const { return buffer + count; }
+	T &front() { return buffer[0]; }
+	T &back() { return buffer[count - 1]; }
+	T &operator[](umm index) { return buffer[index]; }
+	T const &operator[](umm index) const { return buffer[index]; }
+	operator Span<T>() { return Span<T>(buffer, count); }
+	operator Span<T const>() const { return Span<T const>(buffer, count); }
+
+	T *buffer = 0;
+	umm count = 0;
+	umm capacity = 0;
+
+private:
+	void grow() {
+		if (count == capacity)
+			reserve(capacity ? capacity * 2 : 8);
+	}
+};
@@ -34,7 +34,7 @@ SoundBuffer loadWaveFile(char const *path) {
 	
 	SoundBuffer result{};
 
-	auto file = readEntireFile(path);
+	auto file = readEntireFile(path, MemoryTag::audio);
 	if (!file.valid) {
 		goto finish;
 	}
@@ -14,7 +14,10 @@
 #include <Psapi.h>
 #include <strsafe.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <queue>
 #include <stack>
 
@@ -25,99 +28,9 @@ void dummy(void const *) {
 
 }
 
-static void (*pushWorkImpl)(WorkQueue *queue, void (*fn)(void *), void *param);
-static void (*waitForWorkCompletionImpl)(WorkQueue *);
-
-static void doWork(void (*fn)(void *), void *param, WorkQueue *queue) {
-	fn(param);
-	InterlockedDecrement(&queue->workToDo);
-#if !ENG_WORK_USE_TEMP
-	free(param);
-#endif
-}
-
-struct WorkEntry {
-	WorkQueue *queue;
-	void (*function)(void *param);
-	void *param;
-};
-
-struct SharedWorkQueue {
-	std::queue<WorkEntry> queue;
-	std::mutex mutex;
-	void push(WorkEntry &&val) {
-		mutex.lock();
-		queue.push(std::move(val));
-		mutex.unlock();
-	}
-	auto try_pop() {
-		Optional<WorkEntry> entry;
-		mutex.lock();
-		if (queue.size()) {
-			entry.emplace(std::move(queue.front()));
-			queue.pop();
-		}
-		mutex.unlock();
-		return entry;
-	}
-};
-
-static SharedWorkQueue sharedWorkQueue;
-static u32 workerCount = 0;
-static bool volatile stopWork = false;
-static u32 volatile deadWorkers = 0;
-static u32 volatile initializedWorkers = 0;
-static std::unordered_map<DWORD, u32> threadIdMap;
-static bool tryDoWork() {
-	if (auto entry = sharedWorkQueue.try_pop()) {
-		doWork(entry->function, entry->param, entry->queue);
-		return true;
-	}
-	return false;
-}
-void initWorkerThreads(u32 threadCount) {
-	workerCount = threadCount;
-	threadIdMap[GetCurrentThreadId()] = 0;
-	if (threadCount == 0) {
-		pushWorkImpl = [](WorkQueue *queue, void (*fn)(void *), void *param) { doWork(fn, param, queue); };
-		waitForWorkCompletionImpl = [](WorkQueue *queue) {};
-	} else {
-		waitForWorkCompletionImpl = [](WorkQueue *queue) {
-			waitUntil([queue] {
-				tryDoWork();
-				return queue->completed();
-			});
-		};
-		std::mutex threadIdMapMutex;
-		for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex) {
-			std::thread([&threadIdMapMutex, threadIndex]() {
-				threadIdMapMutex.lock();
-				threadIdMap[GetCurrentThreadId()] = threadIndex + 1;
-				threadIdMapMutex.unlock();
-				InterlockedIncrement(&initializedWorkers);
-				for (;;) {
-					waitUntil([] { return tryDoWork() || stopWork; });
-					if (stopWork)
-						break;
-				}
-				InterlockedIncrement(&deadWorkers);
-			}).detach();
-		}
-		pushWorkImpl = [](WorkQueue *queue, void (*fn)(void *), void *param) {
-			sharedWorkQueue.push({queue, fn, param});
-			InterlockedIncrement(&queue->workToDo);
-		};
-	}
-	waitUntil([threadCount] { return initializedWorkers == threadCount; });
-}
-void shutdownWorkerThreads() {
-	stopWork = true;
-	waitUntil([] { return deadWorkers == workerCount; });
-}
-u32 getWorkerThreadCount() { return workerCount; }
-void WorkQueue::push_(void (*fn)(void *), void *param) { return pushWorkImpl(this, fn, param); }
-void WorkQueue::completeAllWork() { return waitForWorkCompletionImpl(this); }
-bool WorkQueue::completed() { return workToDo == 0; }
+#include "job_system.cpp"
+#include "pages.cpp"
+#include "heap.cpp"
 
 struct CPUID {
 	s32 eax;
@@ -174,12 +87,21 @@ static CpuInfo getCpuInfo() {
 		switch (info.Relationship) {
 			case RelationNumaNode:
 			case RelationProcessorPackage: break;
-			case RelationProcessorCore: result.logicalProcessorCount += countBits(info.ProcessorMask); break;
+			case RelationProcessorCore: {
+				result.logicalProcessorCount += countBits(info.ProcessorMask);
+				if (result.coreCount < CpuInfo::maxTopologyEntries)
+					result.coreMasks[result.coreCount++] = info.ProcessorMask;
+				break;
+			}
 			case RelationCache: {
-				auto &cache = result.cache[info.Cache.Level - 1][(u8)cvt(info.Cache.Type)];
+				u32 level = info.Cache.Level - 1;
+				auto type = cvt(info.Cache.Type);
+				auto &cache = result.cache[level][(u8)type];
 				cache.size += info.Cache.Size;
 				++cache.count;
 				result.cacheLineSize = info.Cache.LineSize;
+				if ((type == CacheType::data || type == CacheType::unified) && result.cacheMaskCount[level] < CpuInfo::maxTopologyEntries)
+					result.cacheMasks[level][result.cacheMaskCount[level]++] = info.ProcessorMask;
 				break;
 			}
 			default: INVALID_CODE_PATH("Error: Unsupported LOGICAL_PROCESSOR_RELATIONSHIP value.");
@@ -492,7 +414,7 @@ bool File::valid() {
 	return handle != INVALID_HANDLE_VALUE;
 }
 
-EntireFile readEntireFile(File file) {
+EntireFile readEntireFile(File file, MemoryTag tag) {
 	EntireFile result{};
 	result.valid = true;
 
@@ -503,29 +425,29 @@ EntireFile readEntireFile(File file) {
 	}
 	file.setPointer(0, SeekFrom::begin);
 
-	auto data = malloc(size);
+	auto data = allocateTagged(tag, size);
 	if (file.read(data, size)) {
 		result.data = {(char *)data, size};
 	} else {
-		free(data);
+		freeTagged(data);
 		result.valid = false;
 	}
 	
 	return result;
 }
 
-EntireFile readEntireFile(char const *path) {
+EntireFile readEntireFile(char const *path, MemoryTag tag) {
 	File file(path, File::OpenMode_read);
 	DEFER { file.close(); };
 	if (!file.valid()) {
 		return {};
 	}
-	return readEntireFile(file);
+	return readEntireFile(file, tag);
 }
 
 void freeEntireFile(EntireFile file) { 
 	if (file.valid) {
-		free(file.data.begin()); 
+		freeTagged(file.data.begin()); 
 	}
 }
 
@@ -548,12 +470,7 @@ void init(u32 totalThreadCount) {
 		l.reserve(256);
 	stats.startUs = stats.totalUs = (u64)PerfTimer::getCounter();
 }
-u32 getThreadId() {
-	auto it = threadIdMap.find(GetCurrentThreadId());
-	if (it == threadIdMap.end())
-		return ~0u;
-	return it->second;
-}
+u32 getThreadId() { return currentThreadIndex; }
 void start(char const *name) {
 	u32 threadId = getThreadId();
 	if (threadId == ~0)
@@ -620,7 +537,7 @@ void setHandle(void *newHandle) {
 }
 
 void _print(Span<char const> msg, Span<char const> moduleName) {
-	auto result = format<OsAllocator>("[{}] {}\n", moduleName, msg);
+	auto result = format<HeapAllocator>("[{}] {}\n", moduleName, msg);
 	DWORD charsWritten;
 	WriteConsoleA(handle, result.data(), (DWORD)result.size(), &charsWritten, 0);
 }
@@ -631,45 +548,309 @@ void setColor(Color c) {
 } // namespace Log
 
 #if 1
-static constexpr u32 tempStoragePerThread = 1024 * 1024 * 16;
+// NOTE: every thread reserves this much address space per arena, pages get committed as the arena grows
+static constexpr u32 tempStorageReserve = 1024 * 1024 * 512;
+static constexpr u32 frameStorageReserve = 1024 * 1024 * 256;
+static constexpr u32 tempStorageCommitStep = 1024 * 256;
+static constexpr u32 tempStorageLargePageHead = 1024 * 1024 * 16;
+static u32 tempStorageReleaseDelay = 120;
+static bool tempStorageLargePages = false;
+
+struct ThreadArena {
+	u8 *data = 0;
+	u8 *top = 0;
+	u8 *committedEnd = 0;
+	u8 *reserveEnd = 0;
+	// Highest 'top' of the frame before 'rollbackTemp' lowered it
+	u8 *frameTop = 0;
+	// Highest usage since commit was last trimmed, commit above it gets released every 'tempStorageReleaseDelay' resets
+	u32 highWater = 0;
+	u32 resetsSinceRelease = 0;
+	u32 peak = 0;
+	u32 reclaimed = 0;
+	u32 grownInPlace = 0;
+	u32 stranded = 0;
+	// Committed all at once, never trimmed
+	bool largePages = false;
+};
+
 struct TempStorage {
-	u8 *top = data;
-	u8 data[tempStoragePerThread];
-	TempStorage(){
-		memset(data, 'C', sizeof(data));
-	}
+	ThreadArena temp;
+	// Large page head of the temp arena, used first. A frame that doesn't fit spills into 'temp' and stays there until the reset.
+	ThreadArena largeTemp;
+	PageAllocation largeTempPages{};
+	bool spilled = false;
+	bool largeTempFailed = false;
+	ThreadArena frames[frameStorageCount];
+	u32 threadIndex = ~0;
+	// Held by resets while they touch the arenas and by the owner entering a cross frame job
+	std::mutex resetMutex;
+	u32 crossFrameJobDepth = 0;
+	// Reported again while the arenas can't be reset
+	TempStorageStats lastStats{};
 };
 
-std::unordered_map<DWORD, TempStorage> threadStorages;
-std::mutex threadStorageMutex;
+// NOTE: every thread registers its arenas on first use, the list is only walked between frames and by the usage queries
+static List<TempStorage *> threadStorages;
+static List<TempStorageStats> threadStorageStats;
+static std::mutex threadStorageMutex;
+static thread_local TempStorage *currentTempStorage = 0;
+// NOTE: changed only by 'advanceFrameStorage' between frames
+static u32 currentFrameSlot = 0;
+
+static void initArena(ThreadArena &arena, u32 reserve) {
+	arena.data = (u8 *)VirtualAlloc(0, reserve, MEM_RESERVE, PAGE_READWRITE);
+	if (!arena.data) {
+		FATAL_CODE_PATH("failed to reserve temp storage");
+	}
+	arena.top = arena.data;
+	arena.committedEnd = arena.data;
+	arena.reserveEnd = arena.data + reserve;
+	arena.frameTop = arena.data;
+}
 
-void *allocateTemp(u32 size, u32 align) {
+static TempStorage &registerTempStorage() {
+	auto storage = new TempStorage;
+	initArena(storage->temp, tempStorageReserve);
+	for (auto &frame : storage->frames)
+		initArena(frame, frameStorageReserve);
+	storage->threadIndex = getCurrentThreadIndex();
+	threadStorageMutex.lock();
+	threadStorages.push_back(storage);
+	threadStorageMutex.unlock();
+	currentTempStorage = storage;
+	return *storage;
+}
+
+// Commits up to 'newTop' if needed, it must be within the reserve
+static void moveArenaTop(ThreadArena &arena, u8 *newTop) {
+	if (newTop <= arena.committedEnd) {
+		arena.top = newTop;
+		return;
+	}
+	u8 *newCommittedEnd = min(ceil(newTop, tempStorageCommitStep), arena.reserveEnd);
+	if (!VirtualAlloc(arena.committedEnd, (umm)(newCommittedEnd - arena.committedEnd), MEM_COMMIT, PAGE_READWRITE)) {
+		FATAL_CODE_PATH("failed to commit temp storage");
+	}
+	s64 committed = newCommittedEnd - arena.committedEnd;
+	arena.committedEnd = newCommittedEnd;
+	arena.top = newTop;
+	// NOTE: after 'top' is updated, going over budget logs, which allocates temp memory
+	trackMemory(MemoryTag::temp, committed);
+}
+
+static void *allocateFromArena(ThreadArena &arena, u32 size, u32 align) {
 	align = max(align, 8u);
 	if (!isPowerOf2(align)) {
 		FATAL_CODE_PATH("align is not a power of two");
 	}
 
-	threadStorageMutex.lock();
-	TempStorage &storage = threadStorages[GetCurrentThreadId()];
-	threadStorageMutex.unlock();
-	
-	void *result = ceil(storage.top, align);
-	storage.top = (u8 *)result + size;
-	if (storage.top > storage.data + tempStoragePerThread) {
+	void *result = ceil(arena.top, align);
+	u8 *newTop = (u8 *)result + size;
+	if (newTop > arena.reserveEnd || newTop < arena.top) {
 		FATAL_CODE_PATH("temp storage overflow");
 	}
+	moveArenaTop(arena, newTop);
 	return result;
 }
+
+// Grows 'data' to 'newSize' if it's the last allocation in the arena and the arena has room
+static bool extendArena(ThreadArena &arena, void *data, u32 oldSize, u32 newSize) {
+	u8 *end = (u8 *)data + oldSize;
+	u8 *newTop = (u8 *)data + newSize;
+	if (data < arena.data || end != arena.top || newTop > arena.reserveEnd || newTop < arena.top) {
+		// NOTE: the caller copies, the old block stays behind until the reset
+		arena.stranded += oldSize;
+		return false;
+	}
+	arena.grownInPlace += oldSize;
+	moveArenaTop(arena, newTop);
+	return true;
+}
+
+// Rewinds the arena and returns the most bytes it held at once since the last reset
+static u32 resetArena(ThreadArena &arena) {
+	u32 used = (u32)(max(arena.frameTop, arena.top) - arena.data);
+	arena.highWater = max(arena.highWater, used);
+	arena.peak = max(arena.peak, used);
+	arena.top = arena.data;
+	arena.frameTop = arena.data;
+
+	if (!arena.largePages && ++arena.resetsSinceRelease >= tempStorageReleaseDelay) {
+		u8 *keepEnd = ceil(arena.data + max(arena.highWater, tempStorageCommitStep), tempStorageCommitStep);
+		if (keepEnd < arena.committedEnd) {
+			VirtualFree(keepEnd, (umm)(arena.committedEnd - keepEnd), MEM_DECOMMIT);
+			trackMemory(MemoryTag::temp, -(s64)(arena.committedEnd - keepEnd));
+			arena.committedEnd = keepEnd;
+		}
+		arena.highWater = 0;
+		arena.resetsSinceRelease = 0;
+	}
+	return used;
+}
+
+static void rollbackArena(ThreadArena &arena, u8 *marker) {
+	arena.frameTop = max(arena.frameTop, arena.top);
+	arena.reclaimed += (u32)(arena.top - marker);
+	arena.top = marker;
+}
+
+static void attachLargeTemp(TempStorage &storage) {
+	storage.largeTempPages = allocatePages(MemoryTag::temp, tempStorageLargePageHead, true);
+	if (!storage.largeTempPages.largePages) {
+		freePages(MemoryTag::temp, storage.largeTempPages);
+		storage.largeTempPages = {};
+		storage.largeTempFailed = true;
+		return;
+	}
+	auto &arena = storage.largeTemp;
+	arena.data = (u8 *)storage.largeTempPages.data;
+	arena.top = arena.data;
+	arena.frameTop = arena.data;
+	arena.committedEnd = arena.data + storage.largeTempPages.size;
+	arena.reserveEnd = arena.committedEnd;
+	arena.largePages = true;
+}
+static void detachLargeTemp(TempStorage &storage) {
+	freePages(MemoryTag::temp, storage.largeTempPages);
+	storage.largeTempPages = {};
+	storage.largeTemp = {};
+}
+
+void *allocateTemp(u32 size, u32 align) {
+	TempStorage &storage = currentTempStorage ? *currentTempStorage : registerTempStorage();
+	if (storage.largeTemp.data && !storage.spilled) {
+		if ((u8 *)ceil(storage.largeTemp.top, max(align, 8u)) + size <= storage.largeTemp.reserveEnd)
+			return allocateFromArena(storage.largeTemp, size, align);
+		storage.spilled = true;
+	}
+	return allocateFromArena(storage.temp, size, align);
+}
+void *getTempMarker() {
+	TempStorage &storage = currentTempStorage ? *currentTempStorage : registerTempStorage();
+	return storage.largeTemp.data && !storage.spilled ? storage.largeTemp.top : storage.temp.top;
+}
+void rollbackTemp(void *marker) {
+	ASSERT(currentTempStorage, "temp marker is from another thread");
+	TempStorage &storage = *currentTempStorage;
+	ThreadArena *arena = &storage.temp;
+	if (storage.largeTemp.data && marker >= storage.largeTemp.data && marker <= storage.largeTemp.reserveEnd) {
+		// NOTE: the marker is from before the frame spilled, so everything in the normal arena is newer
+		if (storage.spilled) {
+			rollbackArena(storage.temp, storage.temp.data);
+			storage.spilled = false;
+		}
+		arena = &storage.largeTemp;
+	}
+	ASSERT(marker >= arena->data && marker <= arena->top, "temp marker is from another thread or from a previous frame");
+	rollbackArena(*arena, (u8 *)marker);
+}
+void *allocateFrame(u32 size, u32 align) {
+	TempStorage &storage = currentTempStorage ? *currentTempStorage : registerTempStorage();
+	return allocateFromArena(storage.frames[currentFrameSlot], size, align);
+}
+bool extendTemp(void *data, u32 oldSize, u32 newSize) {
+	TempStorage &storage = currentTempStorage ? *currentTempStorage : registerTempStorage();
+	return extendArena(storage.largeTemp.data && !storage.spilled ? storage.largeTemp : storage.temp, data, oldSize, newSize);
+}
+bool extendFrame(void *data, u32 oldSize, u32 newSize) {
+	TempStorage &storage = currentTempStorage ? *currentTempStorage : registerTempStorage();
+	return extendArena(storage.frames[currentFrameSlot], data, oldSize, newSize);
+}
+
+void beginCrossFrameJob() {
+	TempStorage &storage = currentTempStorage ? *currentTempStorage : registerTempStorage();
+	storage.resetMutex.lock();
+	++storage.crossFrameJobDepth;
+	storage.resetMutex.unlock();
+}
+void endCrossFrameJob() {
+	TempStorage &storage = *currentTempStorage;
+	storage.resetMutex.lock();
+	--storage.crossFrameJobDepth;
+	storage.resetMutex.unlock();
+}
+
+// NOTE: called between frames. Frame jobs are done by then, threads in cross frame jobs may still allocate, their arenas are skipped.
 void resetTempStorage() { 
-	for (auto &[threadId, storage] : threadStorages)
-		storage.top = storage.data;
+	threadStorageMutex.lock();
+	threadStorageStats.clear();
+	for (auto storage : threadStorages) {
+		std::lock_guard lock(storage->resetMutex);
+		if (storage->crossFrameJobDepth) {
+			threadStorageStats.push_back(storage->lastStats);
+			continue;
+		}
+		TempStorageStats stats;
+		stats.threadIndex = storage->threadIndex;
+		stats.used = resetArena(storage->temp);
+		stats.committed = (u32)(storage->temp.committedEnd - storage->temp.data);
+		stats.peak = storage->temp.peak;
+		stats.reclaimed = storage->temp.reclaimed;
+		storage->temp.reclaimed = 0;
+		stats.largePageBytes = (u32)storage->largeTempPages.size;
+		if (storage->largeTemp.data) {
+			stats.used += resetArena(storage->largeTemp);
+			stats.committed += stats.largePageBytes;
+			stats.peak += storage->largeTemp.peak;
+			stats.reclaimed += storage->largeTemp.reclaimed;
+			storage->largeTemp.reclaimed = 0;
+		}
+		storage->spilled = false;
+		if (tempStorageLargePages && !storage->largeTemp.data && !storage->largeTempFailed) {
+			attachLargeTemp(*storage);
+		} else if (!tempStorageLargePages && storage->largeTemp.data) {
+			detachLargeTemp(*storage);
+		}
+		stats.frameCommitted = 0;
+		stats.grownInPlace = 0;
+		stats.stranded = 0;
+		auto collectGrowth = [&](ThreadArena &arena) {
+			stats.grownInPlace += arena.grownInPlace;
+			stats.stranded += arena.stranded;
+			arena.grownInPlace = 0;
+			arena.stranded = 0;
+		};
+		collectGrowth(storage->temp);
+		collectGrowth(storage->largeTemp);
+		for (auto &frame : storage->frames) {
+			collectGrowth(frame);
+			stats.frameCommitted += (u32)(frame.committedEnd - frame.data);
+		}
+		storage->lastStats = stats;
+		threadStorageStats.push_back(stats);
+	}
+	threadStorageMutex.unlock();
+}
+void advanceFrameStorage() {
+	threadStorageMutex.lock();
+	currentFrameSlot = (currentFrameSlot + 1) % frameStorageCount;
+	for (auto storage : threadStorages) {
+		std::lock_guard lock(storage->resetMutex);
+		if (!storage->crossFrameJobDepth)
+			resetArena(storage->frames[currentFrameSlot]);
+	}
+	threadStorageMutex.unlock();
 }
 u32 getTempMemoryUsage() {
 	u32 result = 0;
-	for (auto &[threadId, storage] : threadStorages)
-		result += (u32)(storage.top - storage.data);
+	threadStorageMutex.lock();
+	for (auto storage : threadStorages)
+		result += (u32)(storage->temp.top - storage->temp.data + storage->largeTemp.top - storage->largeTemp.data);
+	threadStorageMutex.unlock();
+	return result;
+}
+u32 getFrameMemoryUsage() {
+	u32 result = 0;
+	threadStorageMutex.lock();
+	for (auto storage : threadStorages)
+		result += (u32)(storage->frames[currentFrameSlot].top - storage->frames[currentFrameSlot].data);
+	threadStorageMutex.unlock();
 	return result;
 }
+Span<TempStorageStats const> getTempStorageStats() { return Span<TempStorageStats const>(threadStorageStats.data(), threadStorageStats.size()); }
+void setTempStorageReleaseDelay(u32 frameCount) { tempStorageReleaseDelay = max(frameCount, 1u); }
+void setTempStorageLargePages(bool enable) { tempStorageLargePages = enable; }
 #else
 static constexpr u32 tempStorageSize = 1024 * 1024 * 64;
 // TODO: this should be u8 but for some reason trying to write in the middle 
@@ -685,11 +866,98 @@ void *allocateTemp(u32 size, u32 align) {
 void resetTempStorage() { 
 	tempStorageOffset = 0;
 }
+void beginCrossFrameJob() {}
+void endCrossFrameJob() {}
 u32 getTempMemoryUsage() {
 	return tempStorageOffset;
 }
 #endif
 
+struct alignas(64) MemoryTagCounters {
+	std::atomic<u64> liveBytes;
+	std::atomic<u64> peakBytes;
+	std::atomic<u64> allocationCount;
+	std::atomic<u64> budget;
+};
+static MemoryTagCounters memoryTagCounters[(u32)MemoryTag::count]{};
+
+// NOTE: sits right before the pointer 'allocateTagged' returns
+struct TaggedHeader {
+	u64 size;
+	u32 offset;
+	MemoryTag tag;
+};
+static constexpr umm taggedHeaderAlign = 16;
+static_assert(sizeof(TaggedHeader) <= taggedHeaderAlign);
+
+char const *toString(MemoryTag tag) {
+	switch (tag) {
+		case MemoryTag::untagged: return "untagged";
+		case MemoryTag::lightAtlas: return "light atlas";
+		case MemoryTag::audio: return "audio";
+		case MemoryTag::renderer: return "renderer";
+		case MemoryTag::temp: return "temp";
+		case MemoryTag::save: return "save";
+		case MemoryTag::heap: return "heap";
+		default: return "Unknown";
+	}
+}
+void trackMemory(MemoryTag tag, s64 bytes) {
+	auto &counters = memoryTagCounters[(u32)tag];
+	u64 live = counters.liveBytes.fetch_add((u64)bytes, std::memory_order_relaxed) + (u64)bytes;
+	if (bytes <= 0)
+		return;
+	counters.allocationCount.fetch_add(1, std::memory_order_relaxed);
+	u64 peak = counters.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+	}
+	u64 budget = counters.budget.load(std::memory_order_relaxed);
+	if (budget && live > budget && live - (u64)bytes <= budget) {
+		Log::warn("{} memory is over budget: {} of {}", toString(tag), cvtBytes(live), cvtBytes(budget));
+	}
+}
+void *allocateTagged(MemoryTag tag, umm size, umm align) {
+	align = max(align, taggedHeaderAlign);
+	if (!isPowerOf2(align)) {
+		FATAL_CODE_PATH("align is not a power of two");
+	}
+	// NOTE: the header gets a whole alignment step, so the result stays aligned
+	umm offset = align;
+	u8 *base = (u8 *)allocateHeap(size + offset, align);
+	if (!base) {
+		FATAL_CODE_PATH("out of memory");
+	}
+	u8 *result = base + offset;
+	auto &header = *(TaggedHeader *)(result - sizeof(TaggedHeader));
+	header.size = size;
+	header.offset = (u32)offset;
+	header.tag = tag;
+	trackMemory(tag, (s64)size);
+	return result;
+}
+void freeTagged(void *data) {
+	if (!data)
+		return;
+	auto &header = *(TaggedHeader *)((u8 *)data - sizeof(TaggedHeader));
+	trackMemory(header.tag, -(s64)header.size);
+	freeHeap((u8 *)data - header.offset);
+}
+MemoryTagStats getMemoryTagStats(MemoryTag tag) {
+	auto &counters = memoryTagCounters[(u32)tag];
+	MemoryTagStats result;
+	result.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+	result.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+	result.allocationCount = counters.allocationCount.load(std::memory_order_relaxed);
+	result.budget = counters.budget.load(std::memory_order_relaxed);
+	return result;
+}
+void setMemoryBudget(MemoryTag tag, u64 bytes) { memoryTagCounters[(u32)tag].budget.store(bytes, std::memory_order_relaxed); }
+bool isOverBudget(MemoryTag tag) {
+	auto &counters = memoryTagCounters[(u32)tag];
+	u64 budget = counters.budget.load(std::memory_order_relaxed);
+	return budget && counters.liveBytes.load(std::memory_order_relaxed) > budget;
+}
+
 u64 getMemoryUsage() {
 	u64 result = 0;
 
@@ -788,7 +1056,7 @@ ENG_API Span<char const> _getModuleName(void *imageBase) {
 		++nameBegin;
 	}
 	auto moduleNameLength = (umm)(nameEnd - nameBegin);
-	char *result = (char *)malloc(moduleNameLength);
+	char *result = (char *)allocateHeap(moduleNameLength);
 	memcpy(result, nameBegin, moduleNameLength);
 	return Span{result, result + moduleNameLength};
 }
@@ -21,7 +21,10 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 
-#if defined BUILD_ENG
+#if defined BUILD_STATIC
+#define ENG_API
+#define GAME_API extern "C"
+#elif defined BUILD_ENG
 #define ENG_API	 __declspec(dllexport)
 #define GAME_API extern "C" __declspec(dllimport)
 #elif defined BUILD_GAME
@@ -41,6 +44,19 @@
 					"\nFile: " __FILE__                                                                     \
 					"\nLine: " STRINGIZE(__LINE__) "\nFunction: " __FUNCTION__ "\nExpression: " expression, \
 					__VA_ARGS__)
+
+// General purpose heap with per-thread caches, see heap.cpp. Declared ahead of TL, so TL containers default to it.
+// NOTE: TL's 'OsAllocator' belongs to the library and stays on malloc, engine code names 'HeapAllocator' instead
+#include <stddef.h>
+ENG_API void *allocateHeap(size_t size, size_t align = 0);
+// Takes only pointers from 'allocateHeap', from any thread, null is ignored
+ENG_API void freeHeap(void *data);
+struct HeapAllocator {
+	static void *allocate(size_t size, size_t align = 0) { return allocateHeap(size, align); }
+	static void deallocate(void *data) { freeHeap(data); }
+};
+#define TL_DEFAULT_ALLOCATOR ::HeapAllocator
+
 #include "../dep/tl/include/tl/common.h"
 #include "../dep/tl/include/tl/math.h"
 #include "../dep/tl/include/tl/thread.h"
@@ -54,7 +70,9 @@ using namespace TL;
 #endif
 
 #include <thread>
+#include <atomic>
 #include <chrono>
+#include <coroutine>
 #include <mutex>
 #include <tuple>
 
@@ -126,9 +144,13 @@ enum class Color {
 	white,
 };
 
+#if OS_WINDOWS
 extern "C" struct IMAGE_DOS_HEADER __ImageBase;
 
 static Span<char const> _moduleName = _getModuleName(&__ImageBase);
+#else
+static Span<char const> _moduleName = _getModuleName(0);
+#endif
 
 ENG_API void _print(Span<char const> msg, Span<char const> = _moduleName);
 ENG_API void setColor(Color);
@@ -167,16 +189,156 @@ ENG_API void dummy(void const *);
 ENG_API void *allocateTemp(u32 size, u32 align = 0);
 template <class T>
 T *allocateTemp(u32 count = 1) {
-	return (T *)allocateTemp(count * sizeof T, alignof T);
+	return (T *)allocateTemp(count * sizeof(T), alignof(T));
 }
 
+// Position in the calling thread's temp arena, 'rollbackTemp' frees everything the thread allocated after it
+ENG_API void *getTempMarker();
+ENG_API void rollbackTemp(void *marker);
+
+// Frees temp memory the calling thread allocated during the scope. Scopes nest.
+// NOTE: nothing allocated inside may be used after the scope ends. That includes closures of jobs pushed from it,
+// so complete them before the scope closes.
+struct TempScope {
+	void *marker = getTempMarker();
+	TempScope() = default;
+	TempScope(TempScope const &) = delete;
+	TempScope &operator=(TempScope const &) = delete;
+	~TempScope() { rollbackTemp(marker); }
+};
+
 ENG_API u32 getTempMemoryUsage();
 
+// Frame memory lives 'frameStorageCount' frames instead of one: what a frame allocates stays valid and unchanged
+// during the next frame, so work reading the previous frame can overlap the current one. Every thread has its own arenas, same as temp memory.
+static constexpr u32 frameStorageCount = 2;
+ENG_API void *allocateFrame(u32 size, u32 align = 0);
+template <class T>
+T *allocateFrame(u32 count = 1) {
+	return (T *)allocateFrame(count * sizeof(T), alignof(T));
+}
+ENG_API u32 getFrameMemoryUsage();
+
+// Grow the calling thread's last temp or frame allocation to 'newSize' without moving it.
+// Return false if something was allocated after 'data' or the arena is out of room, the caller then allocates and copies.
+ENG_API bool extendTemp(void *data, u32 oldSize, u32 newSize);
+ENG_API bool extendFrame(void *data, u32 oldSize, u32 newSize);
+
+// Temp arena of one thread as of the last 'resetTempStorage'
+struct TempStorageStats {
+	// Same as 'getCurrentThreadIndex', ~0 for threads unknown to the job system
+	u32 threadIndex;
+	// Most bytes in use at once during the last frame
+	u32 used;
+	// Bytes backed by memory, arenas commit as they grow and release commit they haven't needed for a while
+	u32 committed;
+	// Most bytes used in any frame so far
+	u32 peak;
+	// Bytes freed by 'TempScope's during the last frame
+	u32 reclaimed;
+	// Bytes backed by memory in all frame arenas of the thread
+	u32 frameCommitted;
+	// Part of 'committed' on large pages, see 'setTempStorageLargePages'
+	u32 largePageBytes;
+	// Bytes of old buffers that 'ArenaList's didn't leave behind during the last frame because they grew in place
+	u32 grownInPlace;
+	// Bytes of old buffers left behind by 'ArenaList's that had to move, temp and frame arenas alike
+	u32 stranded;
+};
+// One entry per thread that ever allocated temp memory
+ENG_API Span<TempStorageStats const> getTempStorageStats();
+// Commit above the highest usage of the last 'frameCount' frames gets released
+ENG_API void setTempStorageReleaseDelay(u32 frameCount);
+// Puts the first part of every temp arena on large pages, from the next 'resetTempStorage' on.
+// Frames that need more continue in the normal arena.
+ENG_API void setTempStorageLargePages(bool enable);
+
 ENG_API u64 getMemoryUsage();
 
+// Owners of tracked memory. Counters are relaxed atomics, reading them every frame is cheap.
+enum class MemoryTag : u8 {
+	untagged,
+	lightAtlas,
+	audio,
+	// GPU resources, counted by size, not allocated through 'allocateTagged'
+	renderer,
+	// Committed pages of temp and frame arenas
+	temp,
+	save,
+	// Chunks of the general purpose heap, allocations bigger than its size classes aren't counted
+	heap,
+	count,
+};
+ENG_API char const *toString(MemoryTag);
+
+struct MemoryTagStats {
+	u64 liveBytes;
+	u64 peakBytes;
+	// Allocations made so far, frees don't lower it
+	u64 allocationCount;
+	// Zero if there is none
+	u64 budget;
+};
+
+ENG_API void *allocateTagged(MemoryTag tag, umm size, umm align = 0);
+// Takes only pointers from 'allocateTagged', null is ignored
+ENG_API void freeTagged(void *data);
+// Counts memory that doesn't come from 'allocateTagged', 'bytes' is negative when it's released
+ENG_API void trackMemory(MemoryTag tag, s64 bytes);
+ENG_API MemoryTagStats getMemoryTagStats(MemoryTag tag);
+// Going over the budget prints a warning, callers that can shed memory check 'isOverBudget'
+ENG_API void setMemoryBudget(MemoryTag tag, u64 bytes);
+ENG_API bool isOverBudget(MemoryTag tag);
+
+// Whole pages from the OS for big buffers that get streamed through every frame. With 'largePages' it tries
+// large pages first (huge pages on Linux) and falls back to normal pages, 'PageAllocation::largePages' tells which.
+struct PageAllocation {
+	void *data;
+	umm size;
+	bool largePages;
+};
+ENG_API PageAllocation allocatePages(MemoryTag tag, umm size, bool largePages = false);
+ENG_API void freePages(MemoryTag tag, PageAllocation allocation);
+// Windows needs the "Lock pages in memory" privilege for large pages, call once at startup.
+// Returns false if they are unavailable, 'allocatePages' then always uses normal pages.
+ENG_API bool enableLargePages();
+
+struct LargePageStats {
+	// Zero if large pages are not enabled
+	umm pageSize;
+	u32 allocations;
+	// Large page allocations that got normal pages
+	u32 fallbacks;
+	u64 liveBytes;
+};
+ENG_API LargePageStats getLargePageStats();
+
+struct HeapStats {
+	// Memory split into size classes, never released
+	u64 chunkBytes;
+	// Live allocations too big for a size class
+	u64 largeBytes;
+	// Times a thread cache took a batch of blocks from the central store, and gave one back
+	u64 refills;
+	u64 flushes;
+};
+ENG_API HeapStats getHeapStats();
+
+template <MemoryTag tag>
+struct TaggedAllocator {
+	static void *allocate(umm size, umm align = 0) { return allocateTagged(tag, size, align); }
+	static void deallocate(void *data) { freeTagged(data); }
+};
+
 struct TempAllocator {
 	static void *allocate(umm size, umm align = 0) { return allocateTemp((u32)size, (u32)align); }
 	static void deallocate(void *data) {}
+	static bool extend(void *data, umm oldSize, umm newSize) { return extendTemp(data, (u32)oldSize, (u32)newSize); }
+};
+struct FrameAllocator {
+	static void *allocate(umm size, umm align = 0) { return allocateFrame((u32)size, (u32)align); }
+	static void deallocate(void *data) {}
+	static bool extend(void *data, umm oldSize, umm newSize) { return extendFrame(data, (u32)oldSize, (u32)newSize); }
 };
 
 namespace Detail {
@@ -185,41 +347,483 @@ static void invoke(void *rawVals) noexcept {
 	Tuple *fnVals((Tuple *)(rawVals));
 	Tuple &tup = *fnVals;
 	std::invoke(std::move(std::get<indices>(tup))...);
+	tup.~Tuple();
 }
 
 template <class Tuple, umm... indices>
 static constexpr auto getInvoke(std::index_sequence<indices...>) noexcept {
 	return &invoke<Tuple, indices...>;
 }
+
+// Used instead of 'invoke' when the job is cancelled before it starts
+template <class Tuple>
+static void discard(void *rawVals) noexcept {
+	((Tuple *)rawVals)->~Tuple();
+}
 } // namespace Detail
 
 #define ENG_WORK_USE_TEMP 1
 
+// Workers always drain higher lanes first
+enum class JobPriority : u8 {
+	// Work the current frame is waiting for
+	critical,
+	normal,
+	// Loading and streaming. May span frames, threads waiting on higher priority queues never pick it up
+	background,
+	count
+};
+
+// Cancels a group of jobs with a single store. Jobs that haven't started yet are dropped by the scheduler,
+// running ones can poll 'isCancelled' and return early.
+// NOTE: must outlive every job it was given to
+struct CancellationToken {
+	std::atomic<bool> cancelled = false;
+
+	void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+	void reset() { cancelled.store(false, std::memory_order_relaxed); }
+	bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+};
+
 struct ENG_API WorkQueue {
-	u32 volatile workToDo = 0;
+	// NOTE: a job fits in one cache line slot. Closures up to this size that can be copied with memcpy are stored in the slot,
+	// others are allocated and the slot holds a pointer.
+	static constexpr u32 inlineStorageSize = 48;
+
+	// NOTE: only touched through std::atomic_ref
+	u32 workToDo = 0;
+	JobPriority priority;
+	// NOTE: once cancelled, jobs of this queue that haven't started finish without running, so 'completeAllWork' only waits for running ones
+	CancellationToken *cancellation;
+
+	WorkQueue(JobPriority priority = JobPriority::normal, CancellationToken *cancellation = 0) : priority(priority), cancellation(cancellation) {}
 
-	// NOTE: time interval between first call to 'push' and call to 'completeAllWork' MUST NOT cross start-frame or frame-frame boundary
+	// NOTE: time interval between first call to 'push' and call to 'completeAllWork' MUST NOT cross start-frame or frame-frame boundary,
+	// unless the queue is 'background'. Background closures that don't fit inline are heap allocated.
+	// Work that produces a result over several frames should use 'pushPersistent' instead.
 	template <class Fn, class... Args>
 	void push(Fn &&fn, Args &&... args) {
-		using Tuple = std::tuple<std::decay_t<Fn>, std::decay_t<Args>...>;
-#if ENG_WORK_USE_TEMP
-		auto fnParams = allocateTemp(sizeof Tuple);
-#else
-		auto fnParams = malloc(sizeof Tuple);
-#endif
-		new(fnParams) Tuple(std::forward<Fn>(fn), std::forward<Args>(args)...);
-		constexpr auto invokerProc = Detail::getInvoke<Tuple>(std::make_index_sequence<1 + sizeof...(Args)>{});
-
-		push_(invokerProc, fnParams);
+		using Closure = std::decay_t<Fn>;
+		if constexpr (sizeof...(Args) == 0 && sizeof(Closure) <= inlineStorageSize && alignof(Closure) <= alignof(void *) &&
+					  std::is_trivially_copy_constructible_v<Closure> && std::is_trivially_destructible_v<Closure>) {
+			alignas(Closure) u8 storage[sizeof(Closure)];
+			new (storage) Closure(std::forward<Fn>(fn));
+			pushInline_([](void *storage) { (*(Closure *)storage)(); }, storage, sizeof(Closure));
+		} else {
+			using Tuple = std::tuple<std::decay_t<Fn>, std::decay_t<Args>...>;
+			auto fnParams = allocateJobStorage(sizeof(Tuple), alignof(Tuple));
+			new(fnParams) Tuple(std::forward<Fn>(fn), std::forward<Args>(args)...);
+			constexpr auto invokerProc = Detail::getInvoke<Tuple>(std::make_index_sequence<1 + sizeof...(Args)>{});
+
+			push_(invokerProc, fnParams, Detail::discard<Tuple>);
+		}
 	}
-	void push_(void (*fn)(void *), void *param);
+	// Calls 'fn(u32 index)' for every index in [0, count). Publishes one job instead of 'count', threads that pick it up
+	// claim indices one at a time and let one more thread in, so the batch fans out to every worker that is free.
+	// NOTE: all indices share one 'fn', it's called concurrently through a reference
+	template <class Fn>
+	void pushBatch(u32 count, Fn &&fn) {
+		using Closure = std::decay_t<Fn>;
+		auto closure = allocateJobStorage(sizeof(Closure), alignof(Closure));
+		new (closure) Closure(std::forward<Fn>(fn));
+		pushBatch_(count, [](void *closure, u32 index) { (*(Closure *)closure)(index); },
+				   [](void *closure) { ((Closure *)closure)->~Closure(); }, closure);
+	}
+	void pushBatch_(u32 count, void (*fn)(void *closure, u32 index), void (*destroy)(void *closure), void *closure);
+	void *allocateJobStorage(u32 size, u32 align);
+	// 'discard' runs instead of 'fn' if the job gets cancelled
+	void push_(void (*fn)(void *), void *param, void (*discard)(void *) = 0);
+	// Copies 'size' bytes of 'data' into the job slot, 'fn' receives a pointer to the copy
+	void pushInline_(void (*fn)(void *), void const *data, u32 size);
 	void completeAllWork();
 	bool completed();
 };
 
-ENG_API void initWorkerThreads(u32 count);
+// Jobs with dependencies. A job is pushed to the work queue as soon as every job it depends on has finished.
+// Dependencies must be added before their dependents, so insertion order is always a valid serial order.
+// NOTE: same as WorkQueue, time interval between first call to 'add' and call to 'run' MUST NOT cross frame boundary
+struct ENG_API JobGraph {
+	using JobId = u32;
+	static constexpr u32 maxDependents = 16;
+
+	struct Job {
+		void (*function)(void *param);
+		void *param;
+		// Set by 'add' and never changed, 'run' finds the roots by it
+		u32 dependencyCount;
+		// Counted down by finishing dependencies while the graph runs
+		u32 remainingDependencies;
+		StaticList<JobId, maxDependents> dependents;
+	};
+
+	template <class Fn>
+	JobId add(Fn &&fn, std::initializer_list<JobId> dependencies = {}) {
+		using Closure = std::decay_t<Fn>;
+		auto param = allocateTemp(sizeof(Closure), alignof(Closure));
+		new (param) Closure(std::forward<Fn>(fn));
+		return add_([](void *param) {
+			Closure &closure = *(Closure *)param;
+			closure();
+			closure.~Closure();
+		}, param, dependencies.begin(), (u32)dependencies.size());
+	}
+	JobId add_(void (*fn)(void *), void *param, JobId const *dependencies, u32 dependencyCount);
+
+	// Runs all jobs on worker threads, calling thread helps and returns when everything is finished
+	void run();
+	// Runs all jobs on calling thread in insertion order
+	void runSerial();
+
+	List<Job, TempAllocator> jobs;
+	WorkQueue queue{JobPriority::critical};
+
+private:
+	void execute(JobId id);
+};
+
+struct TaskGroup;
+
+// Threads that own state no other thread may touch, like a single threaded graphics context
+enum class NamedThread : u8 {
+	// Runs the main loop, the window and the renderer
+	main,
+	count
+};
+
+// Queues 'fn' to run on 'thread'. Jobs run when that thread calls 'runThreadJobs', which the main loop does once per frame,
+// and while it waits in 'completeAllWork', 'TaskGroup::wait' or 'Future::wait'. The closure is heap allocated.
+template <class Fn>
+void pushToThread(NamedThread thread, Fn &&fn) {
+	using Closure = std::decay_t<Fn>;
+	auto param = new Closure(std::forward<Fn>(fn));
+	pushToThread_(thread, [](void *param) {
+		auto closure = (Closure *)param;
+		(*closure)();
+		delete closure;
+	}, param);
+}
+ENG_API void pushToThread_(NamedThread thread, void (*fn)(void *), void *param);
+// Runs every job queued for 'thread' so far. Must be called from that thread, returns false if there was nothing to run
+ENG_API bool runThreadJobs(NamedThread thread);
+
+// Coroutine job. Does nothing until pushed to a TaskGroup, then runs on worker threads.
+// 'co_await'ing a TaskGroup inside a task suspends it without blocking the worker,
+// the last finished child pushes the rest of the task back to the workers.
+struct [[nodiscard]] Task {
+	struct promise_type {
+		TaskGroup *group = 0;
+
+		Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		auto final_suspend() noexcept {
+			struct FinalAwaiter {
+				bool await_ready() noexcept { return false; }
+				void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+				void await_resume() noexcept {}
+			};
+			return FinalAwaiter{};
+		}
+		void return_void() {}
+		void unhandled_exception() { INVALID_CODE_PATH("unhandled exception in task"); }
+	};
+
+	Task() = default;
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+	Task(Task const &) = delete;
+	Task(Task &&that) : handle(that.handle) { that.handle = {}; }
+	~Task() {
+		if (handle)
+			handle.destroy();
+	}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+// Set of child jobs and tasks. Inside a Task use 'co_await group', anywhere else use 'wait'.
+// NOTE: same as WorkQueue, function children are allocated in temp memory, so the group MUST NOT live across frame boundary
+struct ENG_API TaskGroup {
+	TaskGroup() = default;
+	TaskGroup(TaskGroup const &) = delete;
+	~TaskGroup() { ASSERT(remaining == 1, "TaskGroup destroyed before its children finished"); }
+
+	template <class Fn>
+	void push(Fn &&fn) {
+		using Closure = std::decay_t<Fn>;
+		auto param = allocateTemp(sizeof(Closure), alignof(Closure));
+		new (param) Closure(std::forward<Fn>(fn));
+		push_([](void *param) {
+			Closure &closure = *(Closure *)param;
+			closure();
+			closure.~Closure();
+		}, param);
+	}
+	// Runs 'fn' on 'thread' as a child of this group, e.g. device calls after the loading around them was done on workers
+	template <class Fn>
+	void push(NamedThread thread, Fn &&fn) {
+		std::atomic_ref(remaining).fetch_add(1);
+		pushToThread(thread, [this, fn = std::forward<Fn>(fn)]() mutable {
+			fn();
+			childFinished();
+		});
+	}
+	void push(Task task);
+	void push_(void (*fn)(void *), void *param);
+	// Blocks calling thread, helping with other work until every child is finished
+	void wait();
+	void childFinished();
+
+	bool await_ready() { return std::atomic_ref(remaining).load() == 1; }
+	bool await_suspend(std::coroutine_handle<> awaiter);
+	void await_resume() { std::atomic_ref(remaining).store(1); }
+
+	// NOTE: children count plus one held by the owner until it waits
+	u32 remaining = 1;
+	std::coroutine_handle<> continuation;
+};
+
+inline void Task::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+	TaskGroup *group = handle.promise().group;
+	handle.destroy();
+	group->childFinished();
+}
+
+// State shared by a persistent job and the futures of its result. Freed when the job and every future are done with it.
+struct ENG_API FutureStateBase {
+	// NOTE: 'cancelled' only destroys the closure
+	void (*run)(FutureStateBase *state, bool cancelled);
+	void (*destroy)(FutureStateBase *state);
+	// NOTE: only touched through std::atomic_ref
+	u32 refCount = 2;
+	u32 finished = 0;
+	// Set before 'finished' if the job was dropped, there is no result then
+	bool wasCancelled = false;
+	JobPriority priority = JobPriority::background;
+	CancellationToken *cancellation = 0;
+
+	bool ready();
+	bool cancelled() { return ready() && wasCancelled; }
+	// Blocks calling thread, helping with other work of the job's priority or higher until the job is finished
+	void wait();
+	void retain();
+	void release();
+};
+ENG_API void pushPersistent_(FutureStateBase *state);
+
+template <class T>
+struct FutureState : FutureStateBase {
+	alignas(T) u8 result[sizeof(T)];
+	T &get() { return *(T *)result; }
+};
+template <>
+struct FutureState<void> : FutureStateBase {
+	void get() {}
+};
+
+// Result of 'pushPersistent'. Copies share the result, which stays alive until the last copy is destroyed.
+template <class T>
+struct Future {
+	Future() = default;
+	explicit Future(FutureState<T> *state) : state(state) {}
+	Future(Future const &that) : state(that.state) {
+		if (state)
+			state->retain();
+	}
+	Future(Future &&that) : state(that.state) { that.state = 0; }
+	~Future() {
+		if (state)
+			state->release();
+	}
+	Future &operator=(Future that) {
+		std::swap(state, that.state);
+		return *this;
+	}
+
+	bool valid() const { return state; }
+	bool ready() { return state->ready(); }
+	// Finished without a result because its token was cancelled before the job started
+	bool cancelled() { return state->cancelled(); }
+	void wait() { state->wait(); }
+	// Waits if the job is not finished yet
+	decltype(auto) get() {
+		wait();
+		ASSERT(!state->wasCancelled, "result of a cancelled job");
+		return state->get();
+	}
+
+	FutureState<T> *state = 0;
+};
+
+namespace Detail {
+template <class T, class Fn>
+struct PersistentJob : FutureState<T> {
+	alignas(Fn) u8 fn[sizeof(Fn)];
+
+	PersistentJob(Fn &&fn_) {
+		new (fn) Fn(std::move(fn_));
+		this->run = [](FutureStateBase *base, bool cancelled) {
+			auto job = (PersistentJob *)base;
+			Fn &fn = *(Fn *)job->fn;
+			if (!cancelled) {
+				if constexpr (std::is_void_v<T>)
+					fn();
+				else
+					new (job->result) T(fn());
+			}
+			fn.~Fn();
+		};
+		this->destroy = [](FutureStateBase *base) {
+			auto job = (PersistentJob *)base;
+			if constexpr (!std::is_void_v<T>) {
+				if (!job->wasCancelled)
+					job->get().~T();
+			}
+			delete job;
+		};
+	}
+};
+} // namespace Detail
+
+// Runs 'fn' on the workers with no frame boundary restrictions, the closure and the result are heap allocated.
+// NOTE: the job may run across several frames, so it must not hold on to temp memory between frames.
+// Jobs on frame lanes hold up the frame's waits, long ones belong on the background lane.
+template <class Fn>
+auto pushPersistent(Fn &&fn, JobPriority priority = JobPriority::background, CancellationToken *cancellation = 0) {
+	using Closure = std::decay_t<Fn>;
+	using T = std::invoke_result_t<Closure &>;
+	auto job = new Detail::PersistentJob<T, Closure>(Closure(std::forward<Fn>(fn)));
+	job->priority = priority;
+	job->cancellation = cancellation;
+	pushPersistent_(job);
+	return Future<T>(job);
+}
+
+enum class WorkerPlacement : u8 {
+	// Threads are not pinned, OS is free to move them around
+	unpinned,
+	// One thread per physical core, SMT siblings are left alone
+	physicalCores,
+	// One thread per logical processor, SMT siblings get neighbouring thread indices
+	logicalCores,
+};
+ENG_API char const *toString(WorkerPlacement);
+
+struct WorkerPlacementPolicy {
+	WorkerPlacement placement = WorkerPlacement::unpinned;
+	// Bit i allows logical processor i. Pinned threads are placed only on these, unpinned ones are restricted to them
+	u64 allowedProcessors = ~0ull;
+};
+
+// Number of threads, main thread included, that get a processor of their own under 'policy'
+ENG_API u32 getPlacementThreadCount(WorkerPlacementPolicy policy);
+
+// NOTE: pinned threads are ordered by shared last level cache, then by shared L2,
+// so workers that steal from their neighbours mostly touch warm caches
+ENG_API void initWorkerThreads(u32 count, WorkerPlacementPolicy policy = {});
 ENG_API void shutdownWorkerThreads();
 ENG_API u32 getWorkerThreadCount();
+// 0 is the main thread, 1..N are workers, ~0 is a thread the job system doesn't know about
+ENG_API u32 getCurrentThreadIndex();
+
+struct WorkerIdleStats {
+	static constexpr u32 latencyBucketCount = 16;
+
+	// Time from 'push' waking a parked worker to that worker running.
+	// Bucket 0 is below 1 us, bucket i is [2^(i-1), 2^i) us, last bucket takes everything above.
+	u32 wakeLatency[latencyBucketCount];
+	// Times an idle worker found work while spinning, without parking
+	u32 spinHits;
+	u32 parks;
+};
+
+// How long an idle worker spins looking for work before it parks. Default is 50 us.
+// Longer spin lowers wake latency for bursty frame work at the cost of burning idle cores.
+ENG_API void setWorkerSpinMicroseconds(u32 microseconds);
+ENG_API u32 getWorkerSpinMicroseconds();
+ENG_API WorkerIdleStats getWorkerIdleStats();
+ENG_API void resetWorkerIdleStats();
+
+// Scheduler counters of one thread for the last frame
+struct WorkerStats {
+	u32 jobs;
+	// Jobs taken from other threads' deques or from the shared queue
+	u32 steals;
+	// Deepest this thread's own deques got
+	u32 maxQueueDepth;
+	f32 busyMS;
+	// Time in completeAllWork or TaskGroup::wait with nothing to help with
+	f32 waitMS;
+	// Rest of the frame. For workers that's spinning or parked, for the main thread that's its own code
+	f32 idleMS;
+};
+
+// Closes the current frame, main loop calls it once per frame
+ENG_API void updateWorkerStats();
+// Index 0 is the main thread, 1..N are workers
+ENG_API Span<WorkerStats const> getWorkerStats();
+
+// A cache line padded 'T' for every thread, so threads can accumulate without sharing lines.
+// Slot 0 is the main thread, 1..N are workers. Threads unknown to the job system get the last slot, which they share.
+// NOTE: sized by the worker count at construction, so it must not outlive 'shutdownWorkerThreads'
+template <class T>
+struct PerThread {
+	struct alignas(64) Slot {
+		T value;
+	};
+
+	PerThread() : slotCount(getWorkerThreadCount() + 2), slots(new Slot[slotCount]{}) {}
+	~PerThread() { delete[] slots; }
+	PerThread(PerThread const &) = delete;
+	PerThread &operator=(PerThread const &) = delete;
+
+	// NOTE: only the shared slot may be touched by several threads at once, 'T' has to handle that itself
+	T &local() { return slots[min(getCurrentThreadIndex(), slotCount - 1)].value; }
+	bool isShared(T const &slot) const { return &slot == &slots[slotCount - 1].value; }
+
+	template <class Fn>
+	void forEach(Fn &&fn) {
+		for (u32 i = 0; i < slotCount; ++i) {
+			fn(slots[i].value);
+		}
+	}
+
+	u32 slotCount;
+	Slot *slots;
+};
+
+// Statistics counter for hot loops. Adding touches only the calling thread's line, reading sums every slot.
+// Cache 'local()' outside the loop to skip the thread index lookup.
+struct ShardedCounter {
+	struct Local {
+		std::atomic<u64> *value;
+		bool shared;
+
+		void add(u64 amount) {
+			if (shared)
+				value->fetch_add(amount, std::memory_order_relaxed);
+			else
+				value->store(value->load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+		void increment() { add(1); }
+	};
+
+	Local local() {
+		auto &slot = slots.local();
+		return {&slot, slots.isShared(slot)};
+	}
+	void add(u64 amount) { local().add(amount); }
+	void increment() { add(1); }
+	u64 total() {
+		u64 result = 0;
+		slots.forEach([&](std::atomic<u64> &slot) { result += slot.load(std::memory_order_relaxed); });
+		return result;
+	}
+	// NOTE: an add racing with reset can survive it
+	void reset() {
+		slots.forEach([](std::atomic<u64> &slot) { slot.store(0, std::memory_order_relaxed); });
+	}
+
+	PerThread<std::atomic<u64>> slots;
+};
 
 template <class Pred>
 inline void waitUntil(Pred pred) {
@@ -325,9 +929,18 @@ struct CpuInfo {
 		u32 size;
 	};
 
+	// NOTE: topology masks have a bit per logical processor of the current processor group
+	static constexpr u32 maxTopologyEntries = 64;
+
 	u32 logicalProcessorCount;
 	Cache cache[3][(u32)CacheType::count];
 	u32 cacheLineSize;
+	// SMT siblings of each physical core
+	u64 coreMasks[maxTopologyEntries];
+	u32 coreCount;
+	// Logical processors sharing each data or unified cache, per level
+	u64 cacheMasks[3][maxTopologyEntries];
+	u32 cacheMaskCount[3];
 	u32 features[4];
 	CpuVendor vendor;
 	char brand[49];
@@ -353,7 +966,6 @@ struct CpuInfo {
 };
 extern ENG_API CpuInfo const cpuInfo;
 
-#if OS_WINDOWS
 struct ENG_API PerfTimer {
 	inline PerfTimer() { reset(); }
 	inline s64 getElapsedCounter() { return getCounter() - begin; }
@@ -379,9 +991,123 @@ struct ENG_API PerfTimer {
 private:
 	s64 begin;
 };
-#else
-#error no timer
-#endif
+
+namespace Detail {
+// NOTE: jobs shorter than this cost more to schedule than they save
+static constexpr f32 minParallelJobUs = 20.0f;
+// NOTE: a few chunks per thread leave room for stealing to even out uneven items
+static constexpr u32 parallelChunksPerThread = 4;
+
+// NOTE: measured per-item cost is remembered per call site (lambda type) and smoothed across calls
+template <class Fn>
+inline std::atomic<f32> &parallelItemCost() {
+	static std::atomic<f32> usPerItem = 0.0f;
+	return usPerItem;
+}
+template <class Fn>
+inline f32 updateParallelItemCost(f32 measuredUs) {
+	auto &cost = parallelItemCost<Fn>();
+	f32 oldCost = cost.load(std::memory_order_relaxed);
+	f32 newCost = oldCost == 0 ? measuredUs : lerp(oldCost, measuredUs, 0.25f);
+	cost.store(newCost, std::memory_order_relaxed);
+	return newCost;
+}
+inline u32 getParallelChunkCount(u32 itemCount, f32 usPerItem) {
+	u32 threadCount = getWorkerThreadCount() + 1;
+	if (threadCount == 1)
+		return 1;
+	u32 minGrain = (u32)(minParallelJobUs / max(usPerItem, 0.001f)) + 1;
+	u32 balanceGrain = (itemCount + threadCount * parallelChunksPerThread - 1) / (threadCount * parallelChunksPerThread);
+	u32 grain = max(minGrain, balanceGrain);
+	return (itemCount + grain - 1) / grain;
+}
+inline u32 getChunkBegin(u32 begin, u32 itemCount, u32 chunkCount, u32 chunk) {
+	return begin + (u32)((u64)itemCount * chunk / chunkCount);
+}
+} // namespace Detail
+
+// Calls 'fn(u32 index)' for every index in [begin, end).
+// The first item is run on the calling thread to measure cost, the rest is split into chunks
+// that are big enough to be worth a job. Cheap loops stay on the calling thread.
+template <class Fn>
+void parallelFor(u32 begin, u32 end, Fn &&fn) {
+	if (begin >= end)
+		return;
+
+	PerfTimer timer;
+	fn(begin++);
+	f32 usPerItem = Detail::updateParallelItemCost<std::decay_t<Fn>>(timer.getMicroseconds());
+
+	u32 itemCount = end - begin;
+	u32 chunkCount = Detail::getParallelChunkCount(itemCount, usPerItem);
+	if (chunkCount <= 1) {
+		for (u32 i = begin; i < end; ++i)
+			fn(i);
+		return;
+	}
+
+	auto chunkFn = [&](u32 chunk) {
+		u32 chunkEnd = Detail::getChunkBegin(begin, itemCount, chunkCount, chunk + 1);
+		for (u32 i = Detail::getChunkBegin(begin, itemCount, chunkCount, chunk); i < chunkEnd; ++i)
+			fn(i);
+	};
+	// NOTE: chunks are claimed in order, so neighbouring items still end up on the same thread
+	WorkQueue queue{JobPriority::critical};
+	queue.pushBatch(chunkCount, chunkFn);
+	queue.completeAllWork();
+}
+template <class Fn>
+void parallelFor(u32 count, Fn &&fn) {
+	parallelFor(0, count, std::forward<Fn>(fn));
+}
+
+// Calls 'fn(u32 index, T &accumulator)' for every index in [begin, end).
+// 'init' is accumulated into once, extra chunks start from 'T{}', which must be the identity of 'combine'.
+// Partial results are merged with 'combine(T, T) -> T' in index order, so which thread ran a chunk doesn't matter.
+// NOTE: chunk count comes from measured item cost, so results that depend on grouping, like float sums, can differ in the last bits between calls
+template <class T, class Fn, class Combine>
+T parallelReduce(u32 begin, u32 end, T init, Fn &&fn, Combine &&combine) {
+	if (begin >= end)
+		return init;
+
+	T result = init;
+	PerfTimer timer;
+	fn(begin++, result);
+	f32 usPerItem = Detail::updateParallelItemCost<std::decay_t<Fn>>(timer.getMicroseconds());
+
+	u32 itemCount = end - begin;
+	u32 chunkCount = Detail::getParallelChunkCount(itemCount, usPerItem);
+	if (chunkCount <= 1) {
+		for (u32 i = begin; i < end; ++i)
+			fn(i, result);
+		return result;
+	}
+
+	T *partials = allocateTemp<T>(chunkCount);
+	for (u32 chunk = 0; chunk < chunkCount; ++chunk)
+		new (partials + chunk) T{};
+
+	auto chunkFn = [&](u32 chunk) {
+		T &partial = partials[chunk];
+		u32 chunkEnd = Detail::getChunkBegin(begin, itemCount, chunkCount, chunk + 1);
+		for (u32 i = Detail::getChunkBegin(begin, itemCount, chunkCount, chunk); i < chunkEnd; ++i)
+			fn(i, partial);
+	};
+	// NOTE: chunks are claimed in order, so neighbouring items still end up on the same thread
+	WorkQueue queue{JobPriority::critical};
+	queue.pushBatch(chunkCount, chunkFn);
+	queue.completeAllWork();
+
+	for (u32 chunk = 0; chunk < chunkCount; ++chunk) {
+		result = combine(std::move(result), std::move(partials[chunk]));
+		partials[chunk].~T();
+	}
+	return result;
+}
+template <class T, class Fn, class Combine>
+T parallelReduce(u32 count, T init, Fn &&fn, Combine &&combine) {
+	return parallelReduce(0, count, std::move(init), std::forward<Fn>(fn), std::forward<Combine>(combine));
+}
 
 enum class SeekFrom : u32 {
 	begin = 0,
@@ -423,7 +1149,7 @@ struct EntireFile {
 	bool valid;
 };
 
-ENG_API EntireFile readEntireFile(char const *path);
+ENG_API EntireFile readEntireFile(char const *path, MemoryTag tag = MemoryTag::untagged);
 ENG_API void freeEntireFile(EntireFile file);
 
 ENG_API bool fileExists(char const *path);
@@ -14,3 +14,9 @@ ENG_API void setHandle(void *);
 ENG_API void loadOptimizedModule();
 
 ENG_API void resetTempStorage();
+// Makes the oldest frame arena current and frees it, the main loop calls it once per frame
+ENG_API void advanceFrameStorage();
+// The job system wraps jobs that may span frames in these. Arenas of a thread inside such a job are left alone
+// by 'resetTempStorage' and 'advanceFrameStorage', whatever it allocates is freed at the first reset after it's done.
+void beginCrossFrameJob();
+void endCrossFrameJob();
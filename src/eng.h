@@ -10,10 +10,14 @@ struct StartInfo {
 	char const *windowTitle;
 	v2u clientSize;
 	u32 workerThreadCount;
+	WorkerPlacementPolicy workerPlacement;
 	RenderingApi renderingApi;
 	u8 backBufferSampleCount;
 	Format backBufferFormat;
 	bool resizeable;
+	// Large pages for the light atlas and the temp arenas created after startup. Off by default: they are committed up
+	// front and can't be paged out, and the gain is small (see job_benchmark.cpp).
+	bool largePages;
 };
 
 struct EngState {
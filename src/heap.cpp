@@ -0,0 +1,242 @@
+// General purpose heap behind 'allocateHeap'. Every thread keeps free blocks of each size class in its own cache,
+// so most allocations and frees take no lock. Caches trade blocks with a central store in batches, one lock per class.
+// Only needs pages.cpp and the standard library, job_benchmark.cpp pits it against malloc.
+#include <bit>
+
+// NOTE: the header sits right before the returned pointer. Free small blocks reuse it for their links.
+struct HeapHeader {
+	u32 sizeClass;
+	// From the start of the large allocation to the returned pointer
+	u32 offset;
+	// Requested size of large allocations
+	u64 size;
+};
+static constexpr umm heapHeaderSize = sizeof(HeapHeader);
+// Blocks up to this size, header included, come from size classes, bigger ones straight from malloc
+static constexpr umm heapMaxBlockSize = 1024 * 32;
+static constexpr u32 heapClassCount = 40;
+static constexpr u32 heapLargeClass = ~0u;
+static constexpr umm heapChunkSize = 1024 * 64;
+
+// 16 byte steps up to 128, then four classes per doubling
+static constexpr umm getHeapClassSize(u32 sizeClass) {
+	if (sizeClass < 8)
+		return (sizeClass + 1) * 16;
+	u32 step = sizeClass - 8;
+	return (umm)(5 + step % 4) << (5 + step / 4);
+}
+static u32 getHeapSizeClass(umm blockSize) {
+	if (blockSize <= 128)
+		return (u32)((blockSize + 15) / 16) - 1;
+	u32 log2 = (u32)std::bit_width(blockSize - 1) - 1;
+	return 8 + (log2 - 7) * 4 + (u32)((blockSize - 1) >> (log2 - 2)) - 4;
+}
+static_assert(getHeapClassSize(heapClassCount - 1) == heapMaxBlockSize);
+
+// Blocks moved between a thread cache and the central store at once
+static constexpr u32 getHeapBatchSize(u32 sizeClass) { return (u32)max<umm>(4, min<umm>(64, 8192 / getHeapClassSize(sizeClass))); }
+
+struct HeapBlock {
+	HeapBlock *next;
+	// Set on the first block of a batch in the central store
+	HeapBlock *nextBatch;
+};
+static_assert(sizeof(HeapBlock) <= heapHeaderSize);
+
+struct alignas(64) HeapCentralBin {
+	std::mutex mutex;
+	HeapBlock *batches = 0;
+};
+static HeapCentralBin heapCentralBins[heapClassCount];
+
+static std::atomic<u64> heapChunkBytes = 0;
+static std::atomic<u64> heapLargeBytes = 0;
+static std::atomic<u64> heapRefills = 0;
+static std::atomic<u64> heapFlushes = 0;
+
+static void pushHeapBatch(u32 sizeClass, HeapBlock *batch) {
+	auto &central = heapCentralBins[sizeClass];
+	central.mutex.lock();
+	batch->nextBatch = central.batches;
+	central.batches = batch;
+	central.mutex.unlock();
+}
+
+// Splits a new chunk into blocks, returns the first batch and gives the rest to the central store
+static HeapBlock *carveHeapChunk(u32 sizeClass) {
+	umm blockSize = getHeapClassSize(sizeClass);
+	u32 batchSize = getHeapBatchSize(sizeClass);
+	umm chunkSize = ceil(max(heapChunkSize, blockSize * batchSize), normalPageSize);
+	// NOTE: chunks are never given back, blocks of a class only move between caches and the central store
+	u8 *chunk = (u8 *)allocatePages(MemoryTag::heap, chunkSize).data;
+	heapChunkBytes.fetch_add(chunkSize, std::memory_order_relaxed);
+
+	u32 blockCount = (u32)(chunkSize / blockSize);
+	HeapBlock *first = 0;
+	for (u32 batchBegin = 0; batchBegin < blockCount; batchBegin += batchSize) {
+		u32 batchEnd = min(batchBegin + batchSize, blockCount);
+		for (u32 i = batchBegin; i < batchEnd; ++i)
+			((HeapBlock *)(chunk + i * blockSize))->next = i + 1 < batchEnd ? (HeapBlock *)(chunk + (i + 1) * blockSize) : 0;
+		auto batch = (HeapBlock *)(chunk + batchBegin * blockSize);
+		if (first)
+			pushHeapBatch(sizeClass, batch);
+		else
+			first = batch;
+	}
+	return first;
+}
+
+struct HeapThreadBin {
+	HeapBlock *head = 0;
+	u32 count = 0;
+};
+enum class HeapCacheState : u8 { unregistered, live, destroyed };
+// NOTE: trivially destructible, so it stays usable while other thread locals and statics are destroyed.
+// Containers with static storage free into it after the thread's destructors ran, 'state' sends those to the central store.
+struct HeapThreadCache {
+	HeapThreadBin bins[heapClassCount];
+	HeapCacheState state;
+};
+static thread_local HeapThreadCache heapThreadCache;
+
+// Gives the cached blocks back when the thread exits, a thread's blocks outlive it
+struct HeapThreadCacheOwner {
+	HeapThreadCache *cache = 0;
+	~HeapThreadCacheOwner() {
+		if (!cache)
+			return;
+		for (u32 sizeClass = 0; sizeClass < heapClassCount; ++sizeClass) {
+			auto &bin = cache->bins[sizeClass];
+			if (bin.head)
+				pushHeapBatch(sizeClass, bin.head);
+			bin = {};
+		}
+		cache->state = HeapCacheState::destroyed;
+	}
+};
+static thread_local HeapThreadCacheOwner heapThreadCacheOwner;
+
+static void registerHeapThreadCache() {
+	heapThreadCacheOwner.cache = &heapThreadCache;
+	heapThreadCache.state = HeapCacheState::live;
+}
+
+static void refillHeapBin(HeapThreadBin &bin, u32 sizeClass) {
+	heapRefills.fetch_add(1, std::memory_order_relaxed);
+	auto &central = heapCentralBins[sizeClass];
+	central.mutex.lock();
+	HeapBlock *batch = central.batches;
+	if (batch)
+		central.batches = batch->nextBatch;
+	central.mutex.unlock();
+
+	// NOTE: outside of the lock, allocating pages may log, and logging allocates
+	if (!batch) {
+		batch = carveHeapChunk(sizeClass);
+		// NOTE: an allocation or free while logging may have filled this bin already, keep those blocks
+		if (bin.head) {
+			pushHeapBatch(sizeClass, batch);
+			return;
+		}
+	}
+
+	// NOTE: batches from exited threads can be any size
+	u32 count = 0;
+	for (HeapBlock *block = batch; block; block = block->next)
+		++count;
+	bin.head = batch;
+	bin.count = count;
+}
+// Moves a batch from the front of the bin to the central store
+static void flushHeapBin(HeapThreadBin &bin, u32 sizeClass) {
+	heapFlushes.fetch_add(1, std::memory_order_relaxed);
+	u32 batchSize = getHeapBatchSize(sizeClass);
+	HeapBlock *batch = bin.head;
+	HeapBlock *last = batch;
+	for (u32 i = 1; i < batchSize; ++i)
+		last = last->next;
+	bin.head = last->next;
+	bin.count -= batchSize;
+	last->next = 0;
+	pushHeapBatch(sizeClass, batch);
+}
+
+static void *allocateLargeHeap(umm size, umm align) {
+	align = max(align, heapHeaderSize);
+	if (!isPowerOf2(align)) {
+		FATAL_CODE_PATH("align is not a power of two");
+	}
+	// NOTE: malloc returns 16 byte aligned memory, so the header and the alignment fit in 'align' bytes
+	u8 *base = (u8 *)malloc(size + align);
+	if (!base) {
+		FATAL_CODE_PATH("out of memory");
+	}
+	u8 *result = ceil(base + heapHeaderSize, align);
+	auto &header = *(HeapHeader *)(result - heapHeaderSize);
+	header.sizeClass = heapLargeClass;
+	header.offset = (u32)(result - base);
+	header.size = size;
+	heapLargeBytes.fetch_add(size, std::memory_order_relaxed);
+	return result;
+}
+
+void *allocateHeap(size_t size, size_t align) {
+	auto &cache = heapThreadCache;
+	if (cache.state != HeapCacheState::live) {
+		// NOTE: past the thread's destructors nothing would give cached blocks back, malloc is good enough that late
+		if (cache.state == HeapCacheState::destroyed)
+			return allocateLargeHeap(size, align);
+		registerHeapThreadCache();
+	}
+	if (align > heapHeaderSize || size > heapMaxBlockSize - heapHeaderSize)
+		return allocateLargeHeap(size, align);
+
+	u32 sizeClass = getHeapSizeClass(size + heapHeaderSize);
+	auto &bin = cache.bins[sizeClass];
+	if (!bin.head)
+		refillHeapBin(bin, sizeClass);
+	HeapBlock *block = bin.head;
+	bin.head = block->next;
+	--bin.count;
+
+	auto &header = *(HeapHeader *)block;
+	header.sizeClass = sizeClass;
+	header.offset = (u32)heapHeaderSize;
+	return (u8 *)block + heapHeaderSize;
+}
+void freeHeap(void *data) {
+	if (!data)
+		return;
+	auto &header = *(HeapHeader *)((u8 *)data - heapHeaderSize);
+	if (header.sizeClass == heapLargeClass) {
+		heapLargeBytes.fetch_sub(header.size, std::memory_order_relaxed);
+		free((u8 *)data - header.offset);
+		return;
+	}
+
+	// NOTE: blocks go to the freeing thread's cache, whichever thread allocated them
+	u32 sizeClass = header.sizeClass;
+	auto block = (HeapBlock *)((u8 *)data - heapHeaderSize);
+	auto &cache = heapThreadCache;
+	if (cache.state != HeapCacheState::live) {
+		if (cache.state == HeapCacheState::destroyed) {
+			block->next = 0;
+			pushHeapBatch(sizeClass, block);
+			return;
+		}
+		registerHeapThreadCache();
+	}
+	auto &bin = cache.bins[sizeClass];
+	block->next = bin.head;
+	bin.head = block;
+	if (++bin.count >= getHeapBatchSize(sizeClass) * 2)
+		flushHeapBin(bin, sizeClass);
+}
+HeapStats getHeapStats() {
+	HeapStats result;
+	result.chunkBytes = heapChunkBytes.load(std::memory_order_relaxed);
+	result.largeBytes = heapLargeBytes.load(std::memory_order_relaxed);
+	result.refills = heapRefills.load(std::memory_order_relaxed);
+	result.flushes = heapFlushes.load(std::memory_order_relaxed);
+	return result;
+}
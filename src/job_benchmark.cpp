@@ -0,0 +1,441 @@
+// Headless job system stress test and benchmark. Builds without the engine, so it runs on the Linux perf machines:
+//   clang++ -std=c++20 -O2 -pthread src/job_benchmark.cpp -o job_benchmark
+//   ./job_benchmark [job count] [max worker count]
+// For every worker count it reports throughput and p50/p99 latency from 'push' to a job's completion,
+// the per-row cost of 'push' against 'pushBatch' for light atlas sized batches, and the job system sorts against std::sort.
+// Once at the end it compares a light atlas sized update on normal pages, transparent huge pages and MAP_HUGETLB pages,
+// the last ones need 'echo 32 > /proc/sys/vm/nr_hugepages' or they fail and are skipped,
+// and the heap against malloc with 1 to 32 threads allocating and freeing at once.
+#define BUILD_STATIC
+#include "common.h"
+#include "sort.h"
+#include <algorithm>
+#include <condition_variable>
+#include <queue>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Minimal engine for the job system, everything else in common.h stays unresolved
+
+s64 const PerfTimer::frequency = 1000000000;
+s64 PerfTimer::getCounter() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static CpuInfo getBenchmarkCpuInfo() {
+	CpuInfo result{};
+	result.logicalProcessorCount = min(max(1u, std::thread::hardware_concurrency()), CpuInfo::maxTopologyEntries);
+	result.coreCount = result.logicalProcessorCount;
+	for (u32 i = 0; i < result.coreCount; ++i) {
+		result.coreMasks[i] = 1ull << i;
+	}
+	return result;
+}
+CpuInfo const cpuInfo = getBenchmarkCpuInfo();
+
+// NOTE: only the main thread allocates temp memory here, it's reset after every measurement
+static constexpr u32 tempStoragePerThread = 1024 * 1024 * 16;
+struct TempStorage {
+	u8 *data = 0;
+	u8 *top = 0;
+};
+static thread_local TempStorage tempStorage;
+
+void *allocateTemp(u32 size, u32 align) {
+	align = max(align, 8u);
+	if (!tempStorage.data) {
+		tempStorage.data = (u8 *)malloc(tempStoragePerThread);
+		tempStorage.top = tempStorage.data;
+	}
+	void *result = ceil(tempStorage.top, align);
+	tempStorage.top = (u8 *)result + size;
+	if (tempStorage.top > tempStorage.data + tempStoragePerThread) {
+		FATAL_CODE_PATH("temp storage overflow");
+	}
+	return result;
+}
+static void resetTempStorage() { tempStorage.top = tempStorage.data; }
+
+Span<char const> _getModuleName(void *) {
+	static char const name[] = "job_benchmark";
+	return Span<char const>(name, sizeof(name) - 1);
+}
+
+namespace Log {
+void _print(Span<char const> msg, Span<char const> moduleName) {
+	printf("[%.*s] %.*s\n", (int)moduleName.size(), moduleName.data(), (int)msg.size(), msg.data());
+	fflush(stdout);
+}
+// NOTE: plain stdout, colors are dropped
+void setColor(Color) {}
+} // namespace Log
+
+// NOTE: nothing reads the tag counters here
+void trackMemory(MemoryTag, s64) {}
+// NOTE: temp memory is reset only between measurements, when no job runs
+void beginCrossFrameJob() {}
+void endCrossFrameJob() {}
+
+#include "job_system.cpp"
+#include "pages.cpp"
+#include "heap.cpp"
+
+// Benchmark
+
+struct BenchmarkResult {
+	f32 seconds;
+	f32 p50us;
+	f32 p99us;
+};
+
+// Every job writes push-to-completion time into its own slot. Slots start negative, so a lost job fails the check.
+static BenchmarkResult measure(char const *name, List<s64> &latencies, void (*run)(List<s64> &latencies)) {
+	for (auto &latency : latencies) {
+		latency = -1;
+	}
+	PerfTimer timer;
+	run(latencies);
+	BenchmarkResult result;
+	result.seconds = timer.getSeconds();
+
+	s64 *begin = latencies.data();
+	s64 *end = begin + latencies.size();
+	for (s64 *it = begin; it != end; ++it) {
+		if (*it < 0) {
+			FATAL_CODE_PATH("job was lost");
+		}
+	}
+	s64 *p50 = begin + latencies.size() / 2;
+	s64 *p99 = begin + latencies.size() * 99 / 100;
+	std::nth_element(begin, p50, end);
+	result.p50us = PerfTimer::getMicroseconds(*p50);
+	std::nth_element(begin, p99, end);
+	result.p99us = PerfTimer::getMicroseconds(*p99);
+
+	Log::print("    {}: {} Mjobs/s, {} ms, p50 {} us, p99 {} us", name, (f32)latencies.size() / result.seconds / 1000000.0f,
+			   result.seconds * 1000.0f, result.p50us, result.p99us);
+	resetTempStorage();
+	return result;
+}
+
+// NOTE: bursts stay within the pushing thread's deque, like a frame's worth of jobs
+static constexpr u32 burstSize = (u32)WorkDeque::capacity;
+static constexpr u32 nestedOuterBurstSize = 32;
+static constexpr u32 nestedInnerJobCount = 256;
+
+static void pushTimedJob(WorkQueue &queue, s64 *slot) {
+	queue.push([slot, pushed = PerfTimer::getCounter()] { *slot = PerfTimer::getCounter() - pushed; });
+}
+
+// Empty jobs pushed from the main thread, measures scheduling overhead only
+static void runMicrojobs(List<s64> &latencies) {
+	WorkQueue queue;
+	u32 jobCount = (u32)latencies.size();
+	for (u32 burstBegin = 0; burstBegin < jobCount; burstBegin += burstSize) {
+		u32 burstEnd = min(burstBegin + burstSize, jobCount);
+		for (u32 i = burstBegin; i < burstEnd; ++i) {
+			pushTimedJob(queue, &latencies[i]);
+		}
+		queue.completeAllWork();
+	}
+}
+
+// Jobs that push their own queue of microjobs and wait for it, so waiting workers have to help out
+static void runNestedQueues(List<s64> &latencies) {
+	WorkQueue queue;
+	u32 jobCount = (u32)latencies.size();
+	u32 outerStride = nestedOuterBurstSize * nestedInnerJobCount;
+	for (u32 burstBegin = 0; burstBegin < jobCount; burstBegin += outerStride) {
+		u32 burstEnd = min(burstBegin + outerStride, jobCount);
+		for (u32 outerBegin = burstBegin; outerBegin < burstEnd; outerBegin += nestedInnerJobCount) {
+			s64 *slots = &latencies[outerBegin];
+			u32 innerCount = min(nestedInnerJobCount, burstEnd - outerBegin);
+			queue.push([slots, innerCount] {
+				WorkQueue nested;
+				for (u32 i = 0; i < innerCount; ++i) {
+					pushTimedJob(nested, slots + i);
+				}
+				nested.completeAllWork();
+			});
+		}
+		queue.completeAllWork();
+	}
+}
+
+// One job in 64 is a few hundred times heavier, so finishing a burst depends on stealing
+static void runUnevenWork(List<s64> &latencies) {
+	WorkQueue queue;
+	u32 jobCount = (u32)latencies.size();
+	for (u32 burstBegin = 0; burstBegin < jobCount; burstBegin += burstSize) {
+		u32 burstEnd = min(burstBegin + burstSize, jobCount);
+		for (u32 i = burstBegin; i < burstEnd; ++i) {
+			u32 hash = i * 0x9E3779B9u;
+			u32 iterations = (hash >> 26) == 0 ? 16384 : 32;
+			queue.push([slot = &latencies[i], iterations, pushed = PerfTimer::getCounter()] {
+				u32 volatile sink = 0;
+				for (u32 j = 0; j < iterations; ++j) {
+					sink = sink + j;
+				}
+				*slot = PerfTimer::getCounter() - pushed;
+			});
+		}
+		queue.completeAllWork();
+	}
+}
+
+// Light atlas sized batches: a job per row pushed one by one against a single 'pushBatch'.
+// Rows are empty, so the time is scheduling cost only.
+static void benchmarkBatches() {
+	static constexpr u32 rowCounts[] = {12, 16, 24, 32};
+	static constexpr u32 roundCount = 20000;
+	u32 rows[32];
+
+	for (u32 rowCount : rowCounts) {
+		WorkQueue queue;
+		PerfTimer timer;
+		for (u32 round = 0; round < roundCount; ++round) {
+			for (u32 row = 0; row < rowCount; ++row) {
+				queue.push([&rows, row] { rows[row] = row; });
+			}
+			queue.completeAllWork();
+		}
+		f32 pushNs = timer.getNanoseconds() / (roundCount * rowCount);
+		resetTempStorage();
+
+		timer.reset();
+		for (u32 round = 0; round < roundCount; ++round) {
+			queue.pushBatch(rowCount, [&rows](u32 row) { rows[row] = row; });
+			queue.completeAllWork();
+		}
+		f32 batchNs = timer.getNanoseconds() / (roundCount * rowCount);
+		resetTempStorage();
+
+		Log::print("    {} rows: push {} ns/row, pushBatch {} ns/row", rowCount, pushNs, batchNs);
+	}
+}
+
+// parallelSort and radixSort against std::sort on random keys. Every round sorts a fresh copy of the same input.
+static void benchmarkSorts() {
+	static constexpr u32 itemCounts[] = {1024, 1024 * 16, 1024 * 128, 1024 * 1024};
+	static constexpr u32 itemsPerSize = 1024 * 1024 * 4;
+
+	std::mt19937_64 random{42};
+	for (u32 itemCount : itemCounts) {
+		u32 roundCount = max(1u, itemsPerSize / itemCount);
+		List<u64> input;
+		List<u64> items;
+		input.resize(itemCount);
+		items.resize(itemCount);
+		for (auto &item : input) {
+			item = random();
+		}
+
+		auto run = [&](auto sort, auto key) {
+			PerfTimer timer;
+			for (u32 round = 0; round < roundCount; ++round) {
+				memcpy(items.data(), input.data(), itemCount * sizeof(u64));
+				sort(items.data(), items.data() + itemCount);
+				resetTempStorage();
+			}
+			for (u32 i = 1; i < itemCount; ++i) {
+				if (key(items[i - 1]) > key(items[i])) {
+					FATAL_CODE_PATH("items are not sorted");
+				}
+			}
+			return timer.getNanoseconds() / ((f32)roundCount * itemCount);
+		};
+		auto fullKey = [](u64 item) { return item; };
+		// NOTE: high halves only, 'u32' keys with the items dragged along
+		auto highKey = [](u64 item) { return (u32)(item >> 32); };
+		f32 stdNs = run([](u64 *begin, u64 *end) { std::sort(begin, end); }, fullKey);
+		f32 mergeNs = run([](u64 *begin, u64 *end) { parallelSort(begin, end); }, fullKey);
+		f32 radix64Ns = run([](u64 *begin, u64 *end) { radixSort(begin, end); }, fullKey);
+		f32 radix32Ns = run([&](u64 *begin, u64 *end) { radixSort(begin, end, highKey); }, highKey);
+		Log::print("    sort {} items: std::sort {} ns/item, parallelSort {}, radixSort u64 {}, radixSort u32 key {}", itemCount, stdNs,
+				   mergeNs, radix64Ns, radix32Ns);
+	}
+}
+
+// Counts data TLB read misses of the calling thread, ~0 if the kernel doesn't allow it
+struct TlbMissCounter {
+	int fd = -1;
+
+	TlbMissCounter() {
+		perf_event_attr attr{};
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.size = sizeof(attr);
+		attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (fd >= 0)
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	}
+	~TlbMissCounter() {
+		if (fd >= 0)
+			close(fd);
+	}
+	void start() {
+		if (fd >= 0)
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	u64 stop() {
+		if (fd < 0)
+			return ~0ull;
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		u64 result = 0;
+		if (read(fd, &result, sizeof(result)) != sizeof(result))
+			return ~0ull;
+		return result;
+	}
+};
+
+// Light atlas update over probe memory from each kind of page: every sample of every probe is blended with
+// a new value row by row on the job system, then the atlas moves by a probe, like 'LightAtlas::move'.
+// The TLB misses are from a serial blend, so they aren't split across threads.
+static void benchmarkPages() {
+	static constexpr u32 width = 256;
+	static constexpr u32 height = 128;
+	static constexpr u32 sampleCount = 128;
+	static constexpr u32 roundCount = 20;
+	static constexpr umm probeFloats = sampleCount * 3;
+	static constexpr umm rowFloats = width * probeFloats;
+	static constexpr umm dataSize = height * rowFloats * sizeof(f32);
+
+	auto blendRow = [](f32 *voxels, u32 y) {
+		f32 *row = voxels + y * rowFloats;
+		for (umm i = 0; i < rowFloats; ++i)
+			row[i] = row[i] * 0.9f + (f32)(i & 15) * 0.1f;
+	};
+	auto run = [&](char const *name, void *data) {
+		if (!data) {
+			Log::print("    {}: unavailable", name);
+			return;
+		}
+		f32 *voxels = (f32 *)data;
+		memset(voxels, 0, dataSize);
+
+		PerfTimer timer;
+		for (u32 round = 0; round < roundCount; ++round) {
+			parallelFor(height, [&](u32 y) { blendRow(voxels, y); });
+			memmove(voxels, voxels + probeFloats, dataSize - probeFloats * sizeof(f32));
+			resetTempStorage();
+		}
+		f32 updateMs = timer.getMilliseconds() / roundCount;
+
+		TlbMissCounter counter;
+		counter.start();
+		for (u32 y = 0; y < height; ++y)
+			blendRow(voxels, y);
+		u64 misses = counter.stop();
+
+		if (misses == ~0ull)
+			Log::print("    {}: {} ms/update, dTLB read misses n/a", name, updateMs);
+		else
+			Log::print("    {}: {} ms/update, {} dTLB read misses per serial update", name, updateMs, misses);
+	};
+
+	Log::print("pages, {} MB of probes:", dataSize / (1024 * 1024));
+	void *normal = allocateNormalPages(dataSize, false);
+	run("normal pages", normal);
+	releasePages(normal, dataSize);
+
+	void *transparent = allocateNormalPages(dataSize, true);
+	run("transparent huge pages", transparent);
+	releasePages(transparent, dataSize);
+
+	umm hugeSize = ceil(dataSize, defaultHugePageSize);
+	void *huge = allocateLargePages(hugeSize);
+	run("MAP_HUGETLB", huge);
+	if (huge)
+		releasePages(huge, hugeSize);
+}
+
+// Every thread keeps a ring of live allocations of mixed sizes, frees the oldest and allocates a new one.
+// Threads start together, so all of them hit the allocator at once.
+static void benchmarkHeap() {
+	static constexpr u32 threadCounts[] = {1, 2, 4, 8, 16, 32};
+	static constexpr u32 operationsPerThread = 1024 * 1024 * 2;
+	static constexpr u32 liveCount = 256;
+
+	auto run = [](u32 threadCount, auto allocate, auto deallocate) {
+		std::atomic<u32> ready = 0;
+		std::atomic<bool> go = false;
+		List<std::thread> threads;
+		for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex) {
+			threads.push_back(std::thread([&, threadIndex] {
+				void *live[liveCount]{};
+				u32 random = 0x9E3779B9u * (threadIndex + 1);
+				ready.fetch_add(1);
+				while (!go.load()) {
+				}
+				for (u32 i = 0; i < operationsPerThread; ++i) {
+					random ^= random << 13;
+					random ^= random >> 17;
+					random ^= random << 5;
+					// NOTE: mostly small, one in 64 is a few kilobytes
+					umm size = (random & 63) == 0 ? 4096 + (random >> 20) : 16 + ((random >> 8) & 511);
+					void *&slot = live[i % liveCount];
+					deallocate(slot);
+					slot = allocate(size);
+					*(u8 *)slot = (u8)i;
+				}
+				for (auto data : live)
+					deallocate(data);
+			}));
+		}
+		while (ready.load() != threadCount) {
+		}
+		PerfTimer timer;
+		go.store(true);
+		for (auto &thread : threads)
+			thread.join();
+		return (f32)threadCount * operationsPerThread / timer.getSeconds() / 1000000.0f;
+	};
+
+	Log::print("heap:");
+	for (u32 threadCount : threadCounts) {
+		f32 mallocMops = run(threadCount, [](umm size) { return malloc(size); }, [](void *data) { free(data); });
+		f32 heapMops = run(threadCount, [](umm size) { return allocateHeap(size); }, [](void *data) { freeHeap(data); });
+		auto stats = getHeapStats();
+		Log::print("    {} threads: malloc {} Mops/s, allocateHeap {} Mops/s, {} refills, {} flushes so far", threadCount, mallocMops, heapMops,
+				   stats.refills, stats.flushes);
+	}
+}
+
+int main(int argc, char **argv) {
+	u32 jobCount = argc > 1 ? (u32)atoi(argv[1]) : 1024 * 1024 * 4;
+	u32 maxWorkerCount = argc > 2 ? (u32)atoi(argv[2]) : cpuInfo.logicalProcessorCount - 1;
+	ASSERT(jobCount > 0, "job count must be positive");
+
+	List<s64> latencies;
+	latencies.resize(jobCount);
+
+	Log::print("{} jobs, {} logical processors", jobCount, cpuInfo.logicalProcessorCount);
+	for (u32 workerCount = 0;; workerCount = workerCount ? min(workerCount * 2, maxWorkerCount) : 1) {
+		initWorkerThreads(workerCount);
+		Log::print("{} workers:", workerCount);
+		measure("microjobs", latencies, runMicrojobs);
+		measure("nested queues", latencies, runNestedQueues);
+		measure("uneven work", latencies, runUnevenWork);
+		benchmarkBatches();
+		benchmarkSorts();
+		auto idleStats = getWorkerIdleStats();
+		Log::print("    spin hits {}, parks {}", idleStats.spinHits, idleStats.parks);
+		resetWorkerIdleStats();
+		// NOTE: once, with all workers
+		if (workerCount == maxWorkerCount)
+			benchmarkPages();
+		shutdownWorkerThreads();
+		if (workerCount == maxWorkerCount)
+			break;
+	}
+	benchmarkHeap();
+	return 0;
+}
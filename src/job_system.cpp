@@ -0,0 +1,870 @@
+// Job system. Only standard threads and atomics plus thread affinity, so it also runs headless on Linux (see job_benchmark.cpp).
+#if !OS_WINDOWS
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// NOTE: counters shared with the header are plain u32, every concurrent access goes through these
+static u32 atomicIncrement(u32 &value) { return std::atomic_ref(value).fetch_add(1) + 1; }
+static u32 atomicDecrement(u32 &value) { return std::atomic_ref(value).fetch_sub(1) - 1; }
+static u32 atomicLoad(u32 &value) { return std::atomic_ref(value).load(); }
+
+struct WorkEntry {
+	WorkQueue *queue;
+	void (*function)(void *storage);
+	alignas(void *) u8 storage[WorkQueue::inlineStorageSize];
+};
+static_assert(sizeof(WorkEntry) == 64, "job slot must fit in a cache line");
+
+static void (*pushWorkImpl)(WorkEntry const &entry);
+static void (*waitForWorkCompletionImpl)(WorkQueue *);
+
+enum class WorkerActivity : u8 { other, busy, wait, count };
+
+// NOTE: written only by the owning thread, 'updateWorkerStats' diffs them against the previous frame
+struct alignas(64) WorkerCounters {
+	std::atomic<u64> jobs;
+	std::atomic<u64> steals;
+	std::atomic<s64> time[(u32)WorkerActivity::count];
+	std::atomic<u32> maxQueueDepth;
+	WorkerActivity activity;
+	s64 activityBegin;
+};
+template <class T>
+static void addCounter(std::atomic<T> &counter, T value) {
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// NOTE: counter totals at the end of the previous frame
+struct WorkerTotals {
+	u64 jobs;
+	u64 steals;
+	s64 busy;
+	s64 wait;
+};
+
+static WorkerCounters *workerCounters = 0;
+static WorkerTotals *previousWorkerTotals = 0;
+static WorkerStats *workerStats = 0;
+static s64 lastWorkerStatsCounter = 0;
+static thread_local WorkerCounters *currentCounters = 0;
+
+static void startCounting(u32 threadIndex) {
+	currentCounters = &workerCounters[threadIndex];
+	currentCounters->activity = WorkerActivity::other;
+	currentCounters->activityBegin = PerfTimer::getCounter();
+}
+
+// Closes the time slice of the current activity and starts a new one, returns the previous activity
+static WorkerActivity switchActivity(WorkerActivity activity) {
+	auto counters = currentCounters;
+	if (!counters)
+		return activity;
+	s64 now = PerfTimer::getCounter();
+	addCounter(counters->time[(u32)counters->activity], now - counters->activityBegin);
+	auto previous = counters->activity;
+	counters->activity = activity;
+	counters->activityBegin = now;
+	return previous;
+}
+
+// NOTE: slot contents of jobs that did not fit inline
+struct IndirectJob {
+	void (*function)(void *param);
+	void (*discard)(void *param);
+	void *param;
+	bool ownsParam;
+};
+static void invokeIndirect(void *storage) {
+	IndirectJob job = *(IndirectJob *)storage;
+	job.function(job.param);
+	if (job.ownsParam)
+		freeHeap(job.param);
+}
+static void discardIndirect(void *storage) {
+	IndirectJob job = *(IndirectJob *)storage;
+	if (job.discard)
+		job.discard(job.param);
+	if (job.ownsParam)
+		freeHeap(job.param);
+}
+
+// State of a 'pushBatch', shared by every thread that runs a part of it
+struct JobBatch {
+	void (*function)(void *closure, u32 index);
+	void (*destroy)(void *closure);
+	void *closure;
+	WorkQueue *queue;
+	u32 count;
+	u32 maxRunners;
+	bool ownsMemory;
+	// NOTE: only touched through the atomic helpers
+	u32 nextIndex;
+	u32 spawnedRunners;
+	u32 aliveRunners;
+};
+static void invokeBatch(void *storage);
+
+static void pushBatchRunner(JobBatch *batch) {
+	atomicIncrement(batch->aliveRunners);
+	batch->queue->pushInline_(invokeBatch, &batch, sizeof(batch));
+}
+static void retireBatchRunner(JobBatch *batch) {
+	if (atomicDecrement(batch->aliveRunners) != 0)
+		return;
+	batch->destroy(batch->closure);
+	if (batch->ownsMemory) {
+		freeHeap(batch->closure);
+		freeHeap(batch);
+	}
+}
+static void invokeBatch(void *storage) {
+	JobBatch *batch = *(JobBatch **)storage;
+	// NOTE: one runner lets the next one in before it starts claiming, so the pusher enqueues only the first
+	if (atomicLoad(batch->nextIndex) < batch->count && atomicIncrement(batch->spawnedRunners) <= batch->maxRunners)
+		pushBatchRunner(batch);
+	for (;;) {
+		u32 index = std::atomic_ref(batch->nextIndex).fetch_add(1);
+		if (index >= batch->count)
+			break;
+		batch->function(batch->closure, index);
+	}
+	retireBatchRunner(batch);
+}
+
+static void doWork(WorkEntry &entry) {
+	WorkQueue *queue = entry.queue;
+	if (queue->cancellation && queue->cancellation->isCancelled()) {
+		// NOTE: inline closures are trivially destructible, only allocated ones and batches have something to clean up
+		if (entry.function == invokeIndirect)
+			discardIndirect(entry.storage);
+		else if (entry.function == invokeBatch)
+			retireBatchRunner(*(JobBatch **)entry.storage);
+		atomicDecrement(queue->workToDo);
+		return;
+	}
+	// NOTE: background jobs may outlive the frame, the temp memory they use has to survive resets
+	bool crossFrame = queue->priority == JobPriority::background;
+	if (crossFrame)
+		beginCrossFrameJob();
+	auto previousActivity = switchActivity(WorkerActivity::busy);
+	entry.function(entry.storage);
+	switchActivity(previousActivity);
+	if (crossFrame)
+		endCrossFrameJob();
+	if (currentCounters)
+		addCounter(currentCounters->jobs, 1ull);
+	atomicDecrement(queue->workToDo);
+}
+
+// Vyukov's bounded MPMC ring. Used by threads that are not workers and when a worker's deque overflows.
+// NOTE: ring overflow goes to a locked queue, which should never happen in practice
+struct SharedWorkQueue {
+	static constexpr u64 capacity = 4096;
+
+	struct Cell {
+		std::atomic<u64> sequence;
+		WorkEntry entry;
+	};
+
+	alignas(64) std::atomic<u64> enqueuePos = 0;
+	alignas(64) std::atomic<u64> dequeuePos = 0;
+	alignas(64) Cell cells[capacity];
+
+	std::queue<WorkEntry> overflow;
+	std::mutex overflowMutex;
+	std::atomic<u32> overflowSize = 0;
+
+	SharedWorkQueue() {
+		for (u64 i = 0; i < capacity; ++i) {
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+	void push(WorkEntry const &val) {
+		u64 pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell &cell = cells[pos % capacity];
+			s64 diff = (s64)cell.sequence.load(std::memory_order_acquire) - (s64)pos;
+			if (diff == 0) {
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.entry = val;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return;
+				}
+			} else if (diff < 0) {
+				overflowMutex.lock();
+				overflow.push(val);
+				++overflowSize;
+				overflowMutex.unlock();
+				return;
+			} else {
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	Optional<WorkEntry> try_pop() {
+		Optional<WorkEntry> entry;
+		u64 pos = dequeuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell &cell = cells[pos % capacity];
+			s64 diff = (s64)cell.sequence.load(std::memory_order_acquire) - (s64)(pos + 1);
+			if (diff == 0) {
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					entry.emplace(cell.entry);
+					cell.sequence.store(pos + capacity, std::memory_order_release);
+					return entry;
+				}
+			} else if (diff < 0) {
+				break;
+			} else {
+				pos = dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+		if (!overflowSize.load(std::memory_order_relaxed))
+			return entry;
+		overflowMutex.lock();
+		if (overflow.size()) {
+			entry.emplace(overflow.front());
+			overflow.pop();
+			--overflowSize;
+		}
+		overflowMutex.unlock();
+		return entry;
+	}
+};
+
+// Chase-Lev deque. Owner thread pushes and pops at the bottom without locking,
+// other threads steal from the top.
+struct alignas(64) WorkDeque {
+	static constexpr s64 capacity = 1024;
+
+	alignas(64) std::atomic<s64> top = 0;
+	alignas(64) std::atomic<s64> bottom = 0;
+	WorkEntry entries[capacity];
+
+	bool push(WorkEntry const &entry) {
+		s64 b = bottom.load(std::memory_order_relaxed);
+		s64 t = top.load(std::memory_order_acquire);
+		if (b - t >= capacity)
+			return false;
+		entries[b % capacity] = entry;
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+	Optional<WorkEntry> pop() {
+		Optional<WorkEntry> result;
+		s64 b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		s64 t = top.load(std::memory_order_relaxed);
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return result;
+		}
+		WorkEntry entry = entries[b % capacity];
+		if (t == b) {
+			// last entry, race against thieves
+			bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			if (!won)
+				return result;
+		}
+		result.emplace(entry);
+		return result;
+	}
+	Optional<WorkEntry> steal() {
+		Optional<WorkEntry> result;
+		s64 t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		s64 b = bottom.load(std::memory_order_acquire);
+		if (t < b) {
+			WorkEntry entry = entries[t % capacity];
+			if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				result.emplace(entry);
+		}
+		return result;
+	}
+};
+
+static constexpr u32 laneCount = (u32)JobPriority::count;
+
+static SharedWorkQueue sharedWorkQueues[laneCount];
+// NOTE: 'laneCount' deques per thread
+static WorkDeque *workDeques = 0;
+static u32 workerCount = 0;
+static std::atomic<bool> stopWork = false;
+static std::atomic<u32> deadWorkers = 0;
+static std::atomic<u32> initializedWorkers = 0;
+
+// NOTE: 0 is the main thread, 1..workerCount are workers, ~0 is any other thread
+static thread_local u32 currentThreadIndex = ~0u;
+
+// NOTE: idle workers spin for 'workerSpinCounter' and then park on 'condition'.
+// Pushing work wakes one parked worker, 'parkedCount' lets 'push' skip the lock when nobody is parked.
+struct WorkerParking {
+	std::mutex mutex;
+	std::condition_variable condition;
+	u32 wakeEpoch = 0;
+	s64 wakeRequestCounter = 0;
+	alignas(64) std::atomic<u32> parkedCount = 0;
+};
+struct WorkerIdleCounters {
+	ShardedCounter wakeLatency[WorkerIdleStats::latencyBucketCount];
+	ShardedCounter spinHits;
+	ShardedCounter parks;
+};
+static WorkerParking parking;
+// NOTE: lives between 'initWorkerThreads' and 'shutdownWorkerThreads', its counters are sized by the worker count
+static WorkerIdleCounters *idleCounters = 0;
+static u32 workerSpinMicroseconds = 50;
+static s64 workerSpinCounter = 0;
+
+static WorkDeque &getWorkDeque(u32 threadIndex, u32 lane) { return workDeques[threadIndex * laneCount + lane]; }
+
+struct ThreadJob {
+	void (*function)(void *param);
+	void *param;
+};
+// NOTE: 'pending' lets waits skip the lock when the queue is empty
+struct ThreadJobQueue {
+	std::mutex mutex;
+	std::queue<ThreadJob> jobs;
+	std::atomic<u32> pending = 0;
+};
+static ThreadJobQueue threadJobQueues[(u32)NamedThread::count];
+static u32 const namedThreadIndices[(u32)NamedThread::count] = {0};
+
+// Drains queues of the named threads 'threadIndex' is
+static bool runOwnThreadJobs(u32 threadIndex) {
+	bool result = false;
+	for (u32 i = 0; i < (u32)NamedThread::count; ++i) {
+		if (namedThreadIndices[i] == threadIndex && threadJobQueues[i].pending.load(std::memory_order_relaxed))
+			result |= runThreadJobs((NamedThread)i);
+	}
+	return result;
+}
+
+static Optional<WorkEntry> stealWork(u32 thiefIndex, u32 lane) {
+	u32 dequeCount = workerCount + 1;
+	u32 start = thiefIndex == ~0u ? 0 : thiefIndex + 1;
+	for (u32 i = 0; i < dequeCount; ++i) {
+		u32 victim = (start + i) % dequeCount;
+		if (victim == thiefIndex)
+			continue;
+		if (auto entry = getWorkDeque(victim, lane).steal())
+			return entry;
+	}
+	return sharedWorkQueues[lane].try_pop();
+}
+// NOTE: lanes below 'lowestPriority' are not touched, so a thread waiting for frame work doesn't get stuck in a background job
+static bool tryDoWork(u32 threadIndex, JobPriority lowestPriority = JobPriority::background) {
+	if (runOwnThreadJobs(threadIndex))
+		return true;
+	for (u32 lane = 0; lane <= (u32)lowestPriority; ++lane) {
+		Optional<WorkEntry> entry;
+		if (threadIndex != ~0u)
+			entry = getWorkDeque(threadIndex, lane).pop();
+		if (!entry) {
+			entry = stealWork(threadIndex, lane);
+			if (entry && currentCounters)
+				addCounter(currentCounters->steals, 1ull);
+		}
+		if (entry) {
+			doWork(*entry);
+			return true;
+		}
+	}
+	return false;
+}
+static u32 getWakeLatencyBucket(s64 elapsed) {
+	u32 us = (u32)PerfTimer::getMicroseconds(elapsed);
+	u32 bucket = 0;
+	while (us && bucket < WorkerIdleStats::latencyBucketCount - 1) {
+		us >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+static void wakeWorkers(bool all) {
+	parking.mutex.lock();
+	++parking.wakeEpoch;
+	parking.wakeRequestCounter = PerfTimer::getCounter();
+	parking.mutex.unlock();
+	if (all)
+		parking.condition.notify_all();
+	else
+		parking.condition.notify_one();
+}
+static bool spinForWork(u32 threadIndex) {
+	s64 spinEnd = PerfTimer::getCounter() + workerSpinCounter;
+	do {
+		if (tryDoWork(threadIndex))
+			return true;
+		_mm_pause();
+	} while (PerfTimer::getCounter() < spinEnd);
+	return false;
+}
+static void parkWorker(u32 threadIndex) {
+	parking.mutex.lock();
+	u32 epoch = parking.wakeEpoch;
+	parking.mutex.unlock();
+
+	// NOTE: announce before checking the queues for the last time, 'push' checks 'parkedCount' after publishing its entry,
+	// so either we see the entry here or the pusher sees us and bumps the epoch
+	parking.parkedCount.fetch_add(1);
+	if (tryDoWork(threadIndex)) {
+		parking.parkedCount.fetch_sub(1);
+		return;
+	}
+
+	idleCounters->parks.increment();
+	std::unique_lock lock(parking.mutex);
+	parking.condition.wait(lock, [epoch] { return parking.wakeEpoch != epoch || stopWork; });
+	s64 wakeRequestCounter = parking.wakeRequestCounter;
+	lock.unlock();
+	parking.parkedCount.fetch_sub(1);
+
+	u32 bucket = getWakeLatencyBucket(PerfTimer::getCounter() - wakeRequestCounter);
+	idleCounters->wakeLatency[bucket].increment();
+}
+static void workerLoop(u32 threadIndex) {
+	while (!stopWork) {
+		if (tryDoWork(threadIndex))
+			continue;
+		if (spinForWork(threadIndex)) {
+			idleCounters->spinHits.increment();
+			continue;
+		}
+		parkWorker(threadIndex);
+	}
+}
+void setWorkerSpinMicroseconds(u32 microseconds) {
+	workerSpinMicroseconds = microseconds;
+	workerSpinCounter = (s64)microseconds * PerfTimer::frequency / 1000000;
+}
+u32 getWorkerSpinMicroseconds() { return workerSpinMicroseconds; }
+WorkerIdleStats getWorkerIdleStats() {
+	WorkerIdleStats result{};
+	if (!idleCounters)
+		return result;
+	for (u32 i = 0; i < WorkerIdleStats::latencyBucketCount; ++i) {
+		result.wakeLatency[i] = (u32)idleCounters->wakeLatency[i].total();
+	}
+	result.spinHits = (u32)idleCounters->spinHits.total();
+	result.parks = (u32)idleCounters->parks.total();
+	return result;
+}
+void resetWorkerIdleStats() {
+	if (!idleCounters)
+		return;
+	for (auto &bucket : idleCounters->wakeLatency) {
+		bucket.reset();
+	}
+	idleCounters->spinHits.reset();
+	idleCounters->parks.reset();
+}
+char const *toString(WorkerPlacement placement) {
+	switch (placement) {
+		case WorkerPlacement::unpinned: return "unpinned";
+		case WorkerPlacement::physicalCores: return "physical cores";
+		case WorkerPlacement::logicalCores: return "logical cores";
+		default: return "Unknown";
+	}
+}
+
+struct PlacementSlots {
+	u32 processors[CpuInfo::maxTopologyEntries];
+	u32 count;
+};
+
+static u32 findCacheGroup(u32 level, u64 coreMask) {
+	for (u32 i = 0; i < cpuInfo.cacheMaskCount[level - 1]; ++i) {
+		if ((cpuInfo.cacheMasks[level - 1][i] & coreMask) == coreMask)
+			return i;
+	}
+	return ~0u;
+}
+
+// Logical processors threads get pinned to, in thread index order
+static PlacementSlots getPlacementSlots(WorkerPlacementPolicy policy) {
+	PlacementSlots result{};
+	if (policy.placement == WorkerPlacement::unpinned)
+		return result;
+
+	u32 cores[CpuInfo::maxTopologyEntries];
+	for (u32 i = 0; i < cpuInfo.coreCount; ++i) {
+		cores[i] = i;
+	}
+	std::stable_sort(cores, cores + cpuInfo.coreCount, [](u32 a, u32 b) {
+		u64 maskA = cpuInfo.coreMasks[a];
+		u64 maskB = cpuInfo.coreMasks[b];
+		u32 l3A = findCacheGroup(3, maskA);
+		u32 l3B = findCacheGroup(3, maskB);
+		if (l3A != l3B)
+			return l3A < l3B;
+		return findCacheGroup(2, maskA) < findCacheGroup(2, maskB);
+	});
+
+	for (u32 i = 0; i < cpuInfo.coreCount; ++i) {
+		u64 mask = cpuInfo.coreMasks[cores[i]] & policy.allowedProcessors;
+		for (u32 processor = 0; processor < 64; ++processor) {
+			if (mask & (1ull << processor)) {
+				result.processors[result.count++] = processor;
+				if (policy.placement == WorkerPlacement::physicalCores)
+					break;
+			}
+		}
+	}
+	return result;
+}
+static u64 getThreadAffinity(WorkerPlacementPolicy policy, PlacementSlots const &slots, u32 threadIndex) {
+	if (slots.count == 0)
+		return policy.allowedProcessors;
+	return 1ull << slots.processors[threadIndex % slots.count];
+}
+static void setThreadAffinity(u64 mask) {
+	if (mask == ~0ull)
+		return;
+#if OS_WINDOWS
+	if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask)) {
+		Log::warn("SetThreadAffinityMask failed: {}", (u32)GetLastError());
+	}
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (u32 processor = 0; processor < 64; ++processor) {
+		if (mask & (1ull << processor))
+			CPU_SET(processor, &set);
+	}
+	if (s32 error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+		Log::warn("pthread_setaffinity_np failed: {}", error);
+	}
+#endif
+}
+static void logPlacement(WorkerPlacementPolicy policy, PlacementSlots const &slots, u32 threadCount) {
+	Log::print("Worker placement: {}, {} threads on {} processors", toString(policy.placement), threadCount, slots.count ? slots.count : (u32)countBits(policy.allowedProcessors));
+	for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex) {
+		if (!slots.count)
+			break;
+		u32 processor = slots.processors[threadIndex % slots.count];
+		u64 processorMask = 1ull << processor;
+		Log::print("    thread {}: processor {}, L2 group {}, L3 group {}", threadIndex, processor, (s32)findCacheGroup(2, processorMask), (s32)findCacheGroup(3, processorMask));
+	}
+}
+
+u32 getPlacementThreadCount(WorkerPlacementPolicy policy) {
+	if (policy.placement == WorkerPlacement::unpinned) {
+		u64 allMask = 0;
+		for (u32 i = 0; i < cpuInfo.coreCount; ++i) {
+			allMask |= cpuInfo.coreMasks[i];
+		}
+		return max(1u, (u32)countBits(allMask & policy.allowedProcessors));
+	}
+	return max(1u, getPlacementSlots(policy).count);
+}
+void initWorkerThreads(u32 threadCount, WorkerPlacementPolicy policy) {
+	workerCount = threadCount;
+	setWorkerSpinMicroseconds(workerSpinMicroseconds);
+	stopWork = false;
+	initializedWorkers = 0;
+	deadWorkers = 0;
+	currentThreadIndex = 0;
+
+	workerCounters = new WorkerCounters[threadCount + 1]{};
+	previousWorkerTotals = new WorkerTotals[threadCount + 1]{};
+	workerStats = new WorkerStats[threadCount + 1]{};
+	idleCounters = new WorkerIdleCounters;
+	lastWorkerStatsCounter = PerfTimer::getCounter();
+	startCounting(0);
+
+	PlacementSlots slots = getPlacementSlots(policy);
+	logPlacement(policy, slots, threadCount + 1);
+	setThreadAffinity(getThreadAffinity(policy, slots, 0));
+
+	if (threadCount == 0) {
+		pushWorkImpl = [](WorkEntry const &entry) {
+			WorkEntry copy = entry;
+			atomicIncrement(copy.queue->workToDo);
+			doWork(copy);
+		};
+		waitForWorkCompletionImpl = [](WorkQueue *queue) {};
+	} else {
+		workDeques = new WorkDeque[(threadCount + 1) * laneCount];
+		waitForWorkCompletionImpl = [](WorkQueue *queue) {
+			u32 threadIndex = currentThreadIndex;
+			auto previousActivity = switchActivity(WorkerActivity::wait);
+			waitUntil([queue, threadIndex] {
+				tryDoWork(threadIndex, queue->priority);
+				return queue->completed();
+			});
+			switchActivity(previousActivity);
+		};
+		for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex) {
+			u64 affinity = getThreadAffinity(policy, slots, threadIndex + 1);
+			std::thread([threadIndex, affinity]() {
+				setThreadAffinity(affinity);
+				currentThreadIndex = threadIndex + 1;
+				startCounting(threadIndex + 1);
+				++initializedWorkers;
+				workerLoop(threadIndex + 1);
+				++deadWorkers;
+			}).detach();
+		}
+		pushWorkImpl = [](WorkEntry const &entry) {
+			atomicIncrement(entry.queue->workToDo);
+			u32 threadIndex = currentThreadIndex;
+			u32 lane = (u32)entry.queue->priority;
+			if (threadIndex == ~0u) {
+				sharedWorkQueues[lane].push(entry);
+			} else {
+				auto &deque = getWorkDeque(threadIndex, lane);
+				if (deque.push(entry)) {
+					u32 depth = (u32)(deque.bottom.load(std::memory_order_relaxed) - deque.top.load(std::memory_order_relaxed));
+					auto &maxDepth = workerCounters[threadIndex].maxQueueDepth;
+					if (depth > maxDepth.load(std::memory_order_relaxed))
+						maxDepth.store(depth, std::memory_order_relaxed);
+				} else {
+					sharedWorkQueues[lane].push(entry);
+				}
+			}
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (parking.parkedCount.load(std::memory_order_relaxed))
+				wakeWorkers(false);
+		};
+	}
+	waitUntil([threadCount] { return initializedWorkers == threadCount; });
+}
+void shutdownWorkerThreads() {
+	stopWork = true;
+	wakeWorkers(true);
+	waitUntil([] { return deadWorkers == workerCount; });
+	delete[] workDeques;
+	workDeques = 0;
+	workerCount = 0;
+	currentCounters = 0;
+	delete[] workerCounters;
+	delete[] previousWorkerTotals;
+	delete[] workerStats;
+	delete idleCounters;
+	workerCounters = 0;
+	idleCounters = 0;
+	previousWorkerTotals = 0;
+	workerStats = 0;
+}
+u32 getWorkerThreadCount() { return workerCount; }
+u32 getCurrentThreadIndex() { return currentThreadIndex; }
+void updateWorkerStats() {
+	s64 now = PerfTimer::getCounter();
+	f32 frameMS = PerfTimer::getMilliseconds(lastWorkerStatsCounter, now);
+	lastWorkerStatsCounter = now;
+	for (u32 threadIndex = 0; threadIndex <= workerCount; ++threadIndex) {
+		auto &counters = workerCounters[threadIndex];
+		auto &previous = previousWorkerTotals[threadIndex];
+		WorkerTotals totals;
+		totals.jobs = counters.jobs.load(std::memory_order_relaxed);
+		totals.steals = counters.steals.load(std::memory_order_relaxed);
+		totals.busy = counters.time[(u32)WorkerActivity::busy].load(std::memory_order_relaxed);
+		totals.wait = counters.time[(u32)WorkerActivity::wait].load(std::memory_order_relaxed);
+
+		auto &stats = workerStats[threadIndex];
+		stats.jobs = (u32)(totals.jobs - previous.jobs);
+		stats.steals = (u32)(totals.steals - previous.steals);
+		stats.maxQueueDepth = counters.maxQueueDepth.exchange(0, std::memory_order_relaxed);
+		stats.busyMS = PerfTimer::getMilliseconds(previous.busy, totals.busy);
+		stats.waitMS = PerfTimer::getMilliseconds(previous.wait, totals.wait);
+		stats.idleMS = max(0.0f, frameMS - stats.busyMS - stats.waitMS);
+		previous = totals;
+	}
+}
+Span<WorkerStats const> getWorkerStats() { return Span<WorkerStats const>(workerStats, workerCount + 1); }
+void *WorkQueue::allocateJobStorage(u32 size, u32 align) {
+#if ENG_WORK_USE_TEMP
+	if (priority != JobPriority::background)
+		return allocateTemp(size, align);
+#endif
+	return allocateHeap(size, align);
+}
+void WorkQueue::pushBatch_(u32 count, void (*fn)(void *closure, u32 index), void (*destroy)(void *closure), void *closure) {
+	bool ownsMemory = !ENG_WORK_USE_TEMP || priority == JobPriority::background;
+	if (count == 0) {
+		destroy(closure);
+		if (ownsMemory)
+			freeHeap(closure);
+		return;
+	}
+	auto batch = (JobBatch *)allocateJobStorage(sizeof(JobBatch), alignof(JobBatch));
+	batch->function = fn;
+	batch->destroy = destroy;
+	batch->closure = closure;
+	batch->queue = this;
+	batch->count = count;
+	batch->maxRunners = min(count, workerCount + 1);
+	batch->ownsMemory = ownsMemory;
+	batch->nextIndex = 0;
+	batch->spawnedRunners = 1;
+	batch->aliveRunners = 0;
+	pushBatchRunner(batch);
+}
+void WorkQueue::push_(void (*fn)(void *), void *param, void (*discard)(void *)) {
+	IndirectJob job{fn, discard, param, !ENG_WORK_USE_TEMP || priority == JobPriority::background};
+	pushInline_(invokeIndirect, &job, sizeof(job));
+}
+void WorkQueue::pushInline_(void (*fn)(void *), void const *data, u32 size) {
+	ASSERT(size <= inlineStorageSize);
+	WorkEntry entry;
+	entry.queue = this;
+	entry.function = fn;
+	memcpy(entry.storage, data, size);
+	pushWorkImpl(entry);
+}
+void WorkQueue::completeAllWork() { return waitForWorkCompletionImpl(this); }
+bool WorkQueue::completed() { return atomicLoad(workToDo) == 0; }
+
+JobGraph::JobId JobGraph::add_(void (*fn)(void *), void *param, JobId const *dependencies, u32 dependencyCount) {
+	JobId id = (JobId)jobs.size();
+	jobs.push_back({});
+	Job &job = jobs.back();
+	job.function = fn;
+	job.param = param;
+	job.dependencyCount = dependencyCount;
+	job.remainingDependencies = dependencyCount;
+	for (u32 i = 0; i < dependencyCount; ++i) {
+		ASSERT(dependencies[i] < id, "dependency must be added before its dependent");
+		auto &dependents = jobs[dependencies[i]].dependents;
+		ASSERT(dependents.size() < maxDependents, "too many dependents");
+		dependents.push_back(id);
+	}
+	return id;
+}
+void JobGraph::execute(JobId id) {
+	Job &job = jobs[id];
+	job.function(job.param);
+	for (JobId dependent : job.dependents) {
+		if (atomicDecrement(jobs[dependent].remainingDependencies) == 0) {
+			queue.push([this, dependent] { execute(dependent); });
+		}
+	}
+}
+void JobGraph::run() {
+	// NOTE: roots pushed earlier may already be counting down dependents, so 'remainingDependencies' can't tell roots apart
+	for (JobId id = 0; id < (JobId)jobs.size(); ++id) {
+		if (jobs[id].dependencyCount == 0) {
+			queue.push([this, id] { execute(id); });
+		}
+	}
+	queue.completeAllWork();
+}
+void JobGraph::runSerial() {
+	for (auto &job : jobs) {
+		job.function(job.param);
+	}
+}
+
+// NOTE: nobody waits on this queue, it only carries task and child jobs to the workers.
+// Completion is tracked by TaskGroup::remaining, which also keeps groups from being destroyed while a job still uses them.
+static WorkQueue taskWorkQueue;
+
+void TaskGroup::push(Task task) {
+	atomicIncrement(remaining);
+	auto handle = task.handle;
+	task.handle = {};
+	handle.promise().group = this;
+	taskWorkQueue.push([handle] { handle.resume(); });
+}
+void TaskGroup::push_(void (*fn)(void *), void *param) {
+	atomicIncrement(remaining);
+	taskWorkQueue.push([this, fn, param] {
+		fn(param);
+		childFinished();
+	});
+}
+void TaskGroup::wait() {
+	if (workerCount == 0) {
+		// NOTE: everything else already ran inline, only jobs for this thread can be left
+		while (atomicLoad(remaining) != 1) {
+			ASSERT(runOwnThreadJobs(currentThreadIndex), "TaskGroup waits for a job of another thread");
+		}
+		return;
+	}
+	u32 threadIndex = currentThreadIndex;
+	auto previousActivity = switchActivity(WorkerActivity::wait);
+	waitUntil([this, threadIndex] {
+		tryDoWork(threadIndex, taskWorkQueue.priority);
+		return atomicLoad(remaining) == 1;
+	});
+	switchActivity(previousActivity);
+}
+void TaskGroup::childFinished() {
+	if (atomicDecrement(remaining) == 0) {
+		auto awaiter = continuation;
+		taskWorkQueue.push([awaiter] { awaiter.resume(); });
+	}
+}
+bool TaskGroup::await_suspend(std::coroutine_handle<> awaiter) {
+	continuation = awaiter;
+	return atomicDecrement(remaining) != 0;
+}
+
+void pushToThread_(NamedThread thread, void (*fn)(void *), void *param) {
+	auto &queue = threadJobQueues[(u32)thread];
+	queue.mutex.lock();
+	queue.jobs.push({fn, param});
+	queue.pending.fetch_add(1, std::memory_order_relaxed);
+	queue.mutex.unlock();
+}
+bool runThreadJobs(NamedThread thread) {
+	ASSERT(currentThreadIndex == namedThreadIndices[(u32)thread], "thread jobs must run on their own thread");
+	auto &queue = threadJobQueues[(u32)thread];
+	if (!queue.pending.load(std::memory_order_relaxed))
+		return false;
+
+	// NOTE: jobs pushed by these jobs wait for the next call
+	std::queue<ThreadJob> jobs;
+	queue.mutex.lock();
+	std::swap(jobs, queue.jobs);
+	queue.pending.store(0, std::memory_order_relaxed);
+	queue.mutex.unlock();
+
+	auto previousActivity = switchActivity(WorkerActivity::busy);
+	while (jobs.size()) {
+		ThreadJob job = jobs.front();
+		jobs.pop();
+		job.function(job.param);
+	}
+	switchActivity(previousActivity);
+	return true;
+}
+
+// NOTE: same as 'taskWorkQueue', nobody waits on these, futures track their own jobs
+static WorkQueue persistentWorkQueues[laneCount] = {JobPriority::critical, JobPriority::normal, JobPriority::background};
+
+void pushPersistent_(FutureStateBase *state) {
+	persistentWorkQueues[(u32)state->priority].push([state] {
+		bool cancelled = state->cancellation && state->cancellation->isCancelled();
+		state->wasCancelled = cancelled;
+		// NOTE: futures can be waited on frames later, whatever their priority
+		beginCrossFrameJob();
+		state->run(state, cancelled);
+		endCrossFrameJob();
+		std::atomic_ref(state->finished).store(1, std::memory_order_release);
+		state->release();
+	});
+}
+bool FutureStateBase::ready() { return std::atomic_ref(finished).load(std::memory_order_acquire); }
+void FutureStateBase::wait() {
+	if (ready())
+		return;
+	u32 threadIndex = currentThreadIndex;
+	auto previousActivity = switchActivity(WorkerActivity::wait);
+	waitUntil([this, threadIndex] {
+		tryDoWork(threadIndex, priority);
+		return ready();
+	});
+	switchActivity(previousActivity);
+}
+void FutureStateBase::retain() { std::atomic_ref(refCount).fetch_add(1, std::memory_order_relaxed); }
+void FutureStateBase::release() {
+	if (std::atomic_ref(refCount).fetch_sub(1, std::memory_order_acq_rel) == 1)
+		destroy(this);
+}
@@ -0,0 +1,105 @@
+// Page allocation straight from the OS, with large pages (huge pages on Linux) where they are available.
+// The Linux side exists for job_benchmark.cpp, which compares the kinds of pages on the perf machines.
+#if !OS_WINDOWS
+#include <sys/mman.h>
+#endif
+
+static constexpr umm normalPageSize = 4096;
+#if !OS_WINDOWS
+static constexpr umm defaultHugePageSize = 1024 * 1024 * 2;
+#endif
+
+static umm largePageSize = 0;
+static std::atomic<u32> largePageAllocations = 0;
+static std::atomic<u32> largePageFallbacks = 0;
+static std::atomic<u64> largePageBytes = 0;
+
+#if OS_WINDOWS
+bool enableLargePages() {
+	if (largePageSize)
+		return true;
+	umm pageSize = GetLargePageMinimum();
+	if (!pageSize)
+		return false;
+
+	HANDLE token;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		return false;
+	DEFER { CloseHandle(token); };
+
+	TOKEN_PRIVILEGES privileges{};
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	if (!LookupPrivilegeValueA(0, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid))
+		return false;
+	// NOTE: succeeds even if the account doesn't hold the privilege, that only shows up in the last error
+	if (!AdjustTokenPrivileges(token, false, &privileges, 0, 0, 0) || GetLastError() != ERROR_SUCCESS)
+		return false;
+
+	largePageSize = pageSize;
+	return true;
+}
+static void *allocateLargePages(umm size) { return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE); }
+static void *allocateNormalPages(umm size, bool) { return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE); }
+static void releasePages(void *data, umm) { VirtualFree(data, 0, MEM_RELEASE); }
+#else
+// NOTE: explicit huge pages come from the pool reserved in /proc/sys/vm/nr_hugepages, allocations fall back to
+// transparent huge pages when it's empty
+bool enableLargePages() {
+	largePageSize = defaultHugePageSize;
+	return true;
+}
+static void *allocateLargePages(umm size) {
+	void *result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	return result == MAP_FAILED ? 0 : result;
+}
+static void *allocateNormalPages(umm size, bool adviseHugePages) {
+	void *result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (result == MAP_FAILED)
+		return 0;
+	if (adviseHugePages)
+		madvise(result, size, MADV_HUGEPAGE);
+	return result;
+}
+static void releasePages(void *data, umm size) { munmap(data, size); }
+#endif
+
+PageAllocation allocatePages(MemoryTag tag, umm size, bool largePages) {
+	PageAllocation result{};
+	if (largePages && largePageSize) {
+		result.size = ceil(size, largePageSize);
+		result.data = allocateLargePages(result.size);
+		if (result.data) {
+			result.largePages = true;
+			largePageAllocations.fetch_add(1, std::memory_order_relaxed);
+			largePageBytes.fetch_add(result.size, std::memory_order_relaxed);
+		} else if (largePageFallbacks.fetch_add(1, std::memory_order_relaxed) == 0) {
+			Log::warn("large page allocation of {} bytes failed, using normal pages", (u64)result.size);
+		}
+	}
+	if (!result.data) {
+		result.size = ceil(size, normalPageSize);
+		result.data = allocateNormalPages(result.size, largePages);
+		if (!result.data) {
+			FATAL_CODE_PATH("out of memory");
+		}
+	}
+	trackMemory(tag, (s64)result.size);
+	return result;
+}
+void freePages(MemoryTag tag, PageAllocation allocation) {
+	if (!allocation.data)
+		return;
+	if (allocation.largePages)
+		largePageBytes.fetch_sub(allocation.size, std::memory_order_relaxed);
+	releasePages(allocation.data, allocation.size);
+	trackMemory(tag, -(s64)allocation.size);
+}
+LargePageStats getLargePageStats() {
+	LargePageStats result;
+	result.pageSize = largePageSize;
+	result.allocations = largePageAllocations.load(std::memory_order_relaxed);
+	result.fallbacks = largePageFallbacks.load(std::memory_order_relaxed);
+	result.liveBytes = largePageBytes.load(std::memory_order_relaxed);
+	return result;
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include "common.h"
+#include <tuple>
+
+// Containers that keep items packed for iteration and hand out handles that survive erasing other items.
+// Erasing moves the last item into the hole, like UnorderedList, and patches that item's slot, so only raw indices
+// and pointers go stale. Freed slots are reused, every reuse bumps the slot's generation, so old handles to it fail 'get'.
+
+struct PoolHandle {
+	u32 slot = ~0u;
+	u32 generation = 0;
+
+	bool operator==(PoolHandle const &that) const { return slot == that.slot && generation == that.generation; }
+	bool operator!=(PoolHandle const &that) const { return !(*this == that); }
+	explicit operator bool() const { return slot != ~0u; }
+};
+
+namespace Detail {
+struct PoolSlots {
+	struct Slot {
+		// Dense index while the slot is in use, next free slot otherwise
+		u32 index;
+		u32 generation;
+	};
+	List<Slot> slots;
+	// Slot of every dense item
+	List<u32> denseSlots;
+	u32 firstFree = ~0u;
+
+	// Hands out a slot for an item just appended at the dense end
+	PoolHandle add() {
+		u32 slot;
+		if (firstFree != ~0u) {
+			slot = firstFree;
+			firstFree = slots[slot].index;
+		} else {
+			slot = (u32)slots.size();
+			slots.push_back({0, 0});
+		}
+		slots[slot].index = (u32)denseSlots.size();
+		denseSlots.push_back(slot);
+		return {slot, slots[slot].generation};
+	}
+	// Dense index of the handle's item, ~0 if the handle is stale
+	u32 indexOf(PoolHandle handle) const {
+		if (handle.slot >= slots.size() || slots[handle.slot].generation != handle.generation)
+			return ~0u;
+		return slots[handle.slot].index;
+	}
+	PoolHandle handleAt(u32 index) const {
+		u32 slot = denseSlots[index];
+		return {slot, slots[slot].generation};
+	}
+	// Frees the slot of dense item 'index', the caller moves the last item into 'index'
+	void erase(u32 index) {
+		u32 slot = denseSlots[index];
+		u32 lastSlot = denseSlots.back();
+		slots[lastSlot].index = index;
+		denseSlots[index] = lastSlot;
+		denseSlots.pop_back();
+
+		++slots[slot].generation;
+		slots[slot].index = firstFree;
+		firstFree = slot;
+	}
+	void clear() {
+		while (denseSlots.size())
+			erase((u32)denseSlots.size() - 1);
+	}
+};
+} // namespace Detail
+
+template <class T>
+struct Pool {
+	PoolHandle add(T const &item) {
+		items.push_back(item);
+		return slots.add();
+	}
+	// Null if the item was erased
+	T *get(PoolHandle handle) {
+		u32 index = slots.indexOf(handle);
+		return index == ~0u ? 0 : &items[index];
+	}
+	T const *get(PoolHandle handle) const { return const_cast<Pool *>(this)->get(handle); }
+	PoolHandle handleOf(T const &item) const { return slots.handleAt(indexOf(item)); }
+	u32 indexOf(T const &item) const {
+		ASSERT(items.data() <= &item && &item < items.data() + items.size(), "item is not in the pool");
+		return (u32)(&item - items.data());
+	}
+
+	void eraseAt(u32 index) {
+		slots.erase(index);
+		if (index != items.size() - 1)
+			items[index] = std::move(items.back());
+		items.pop_back();
+	}
+	void erase(PoolHandle handle) {
+		u32 index = slots.indexOf(handle);
+		if (index != ~0u)
+			eraseAt(index);
+	}
+	// NOTE: same as UnorderedList, the last item takes the place of the erased one, so iterate without advancing
+	void erase(T &item) { eraseAt(indexOf(item)); }
+	void erase(T *item) { erase(*item); }
+
+	// Erases from the end or appends default items, handles of the items that stay remain valid
+	void resize(umm count) {
+		while (items.size() > count)
+			eraseAt((u32)items.size() - 1);
+		while (items.size() < count)
+			add(T{});
+	}
+	void clear() {
+		items.clear();
+		slots.clear();
+	}
+
+	u32 size() const { return (u32)items.size(); }
+	bool empty() const { return items.size() == 0; }
+	T *data() { return items.data(); }
+	T const *data() const { return items.data(); }
+	T *begin() { return items.data(); }
+	T *end() { return items.data() + items.size(); }
+	T const *begin() const { return items.data(); }
+	T const *end() const { return items.data() + items.size(); }
+	T &operator[](u32 index) { return items[index]; }
+	T const &operator[](u32 index) const { return items[index]; }
+
+	List<T> items;
+	Detail::PoolSlots slots;
+};
+
+// Pool with every field in its own array, so loops stream only the fields they touch.
+// Fields are addressed by position, name them with an enum.
+template <class ...Fields>
+struct SoaPool {
+	PoolHandle add(Fields const &...values) {
+		std::apply([&](auto &...columns) { (columns.push_back(values), ...); }, columns);
+		return slots.add();
+	}
+	// Dense index of the handle's item, ~0 if it was erased
+	u32 indexOf(PoolHandle handle) const { return slots.indexOf(handle); }
+	PoolHandle handleAt(u32 index) const { return slots.handleAt(index); }
+
+	template <umm field>
+	auto *column() { return std::get<field>(columns).data(); }
+	template <umm field>
+	auto const *column() const { return std::get<field>(columns).data(); }
+	template <umm field>
+	auto &get(u32 index) { return std::get<field>(columns)[index]; }
+
+	// Calls 'fn' with a pointer to every column in field order
+	template <class Fn>
+	void forEachColumn(Fn &&fn) {
+		std::apply([&](auto &...columns) { (fn(columns.data()), ...); }, columns);
+	}
+
+	void eraseAt(u32 index) {
+		slots.erase(index);
+		std::apply([&](auto &...columns) {
+			((index != columns.size() - 1 ? (void)(columns[index] = std::move(columns.back())) : (void)0), ...);
+			(columns.pop_back(), ...);
+		}, columns);
+	}
+	void erase(PoolHandle handle) {
+		u32 index = slots.indexOf(handle);
+		if (index != ~0u)
+			eraseAt(index);
+	}
+	void resize(umm count) {
+		while (size() > count)
+			eraseAt(size() - 1);
+		while (size() < count)
+			add(Fields{}...);
+	}
+	void clear() {
+		std::apply([&](auto &...columns) { (columns.clear(), ...); }, columns);
+		slots.clear();
+	}
+
+	u32 size() const { return (u32)slots.denseSlots.size(); }
+	bool empty() const { return size() == 0; }
+
+	std::tuple<List<Fields>...> columns;
+	Detail::PoolSlots slots;
+};
@@ -38,8 +38,9 @@ struct PS {
 	static constexpr auto create = &ID3D11Device::CreatePixelShader;
 };
 
+// NOTE: compiling doesn't touch the device, so it can run on any thread
 template <class Shader>
-static typename Shader::Type _createShader(StringView src, char const *name, D3D_SHADER_MACRO const *defines) {
+static ID3DBlob *_compileShader(StringView src, char const *name, D3D_SHADER_MACRO const *defines) {
 	ID3DBlob *code{};
 	ID3DBlob *messages{};
 	HRESULT compileResult = D3DCompile(src.data(), src.size(), name, defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
@@ -57,6 +58,10 @@ static typename Shader::Type _createShader(StringView src, char const *name, D3D
 		Log::print("Source: {}", src);
 		INVALID_CODE_PATH("shader compilation failed");
 	}
+	return code;
+}
+template <class Shader>
+static typename Shader::Type _createShader(ID3DBlob *code) {
 	typename Shader::Type shader = 0;
 	DHR((device->*Shader::create)(code->GetBufferPointer(), code->GetBufferSize(), 0, &shader));
 	ASSERT(shader);
@@ -64,14 +69,14 @@ static typename Shader::Type _createShader(StringView src, char const *name, D3D
 	return shader;
 }
 
-#define CREATE_SHADER(createVertexShader, VS)                                                                       \
-	static FORCEINLINE auto createVertexShader(StringView src, char const *name, D3D_SHADER_MACRO const *defines) { \
-		PROFILE_FUNCTION;                                                                                           \
-		return _createShader<VS>(src, name, defines);                                                               \
+#define COMPILE_SHADER(compileVertexShader, VS)                                                                           \
+	static FORCEINLINE ID3DBlob *compileVertexShader(StringView src, char const *name, D3D_SHADER_MACRO const *defines) { \
+		PROFILE_FUNCTION;                                                                                                 \
+		return _compileShader<VS>(src, name, defines);                                                                    \
 	}
-CREATE_SHADER(createVertexShader, VS)
-CREATE_SHADER(createPixelShader, PS)
-#undef CREATE_SHADER
+COMPILE_SHADER(compileVertexShader, VS)
+COMPILE_SHADER(compilePixelShader, PS)
+#undef COMPILE_SHADER
 
 ID3D11Buffer *createBuffer(UINT bindFlags, D3D11_USAGE usage, UINT cpuAccess, UINT size, UINT stride, UINT misc,
 						   void const *initialData) {
@@ -234,6 +239,8 @@ struct RenderTarget {
 	ID3D11Texture2D *texture;
 	v2u size;
 	u32 samplerIndex;
+	// Counted in 'MemoryTag::renderer', zero for the back buffer
+	u32 memorySize;
 };
 struct StructuredBuffer {
 	ID3D11Buffer *buffer;
@@ -249,6 +256,7 @@ struct Texture {
 	ID3D11ShaderResourceView *srv;
 	u32 samplerIndex;
 	u32 rowPitch;
+	u32 memorySize;
 };
 
 static ID3D11BlendState *blends[(u32)Blend::count][(u32)Blend::count][(u32)BlendOp::count]{};
@@ -377,6 +385,8 @@ void create(RenderTarget &rt, v2u size, Format format, u32 sampleCount, Address
 	DHR(device->CreateShaderResourceView(rt.texture, 0, &rt.srv));
 	rt.samplerIndex = (u32)(initSampler(address, filter, borderColor) - &samplers[0][0]);
 	rt.size = size;
+	rt.memorySize = getSize(dxgiFormat) * size.x * size.y * sampleCount;
+	trackMemory(MemoryTag::renderer, rt.memorySize);
 }
 void bind(ID3D11ShaderResourceView *srv, u32 samplerIndex, Stage stage, u32 slot) {
 	auto sampler = &samplers[0][0] + samplerIndex;
@@ -404,6 +414,7 @@ void create(StructuredBuffer &buf, void const *data, u32 stride, u32 count) {
 	desc.Buffer.NumElements = count;
 	DHR(device->CreateShaderResourceView(buf.buffer, &desc, &buf.srv));
 	buf.currentSize = count * stride;
+	trackMemory(MemoryTag::renderer, buf.currentSize);
 }
 bool valid(StructuredBuffer &buf) { return buf.buffer != 0; }
 void update(StructuredBuffer &buf, void const *data, u32 size) {
@@ -429,10 +440,13 @@ void release(RenderTarget &rt) {
 	RELEASE(rt.rtv);
 	RELEASE(rt.srv);
 	RELEASE(rt.texture);
+	trackMemory(MemoryTag::renderer, -(s64)rt.memorySize);
+	rt.memorySize = 0;
 }
 void release(StructuredBuffer &buf) {
 	RELEASE(buf.buffer);
 	RELEASE(buf.srv);
+	trackMemory(MemoryTag::renderer, -(s64)buf.currentSize);
 	buf.currentSize = 0;
 }
 void release(Shader &sh) {
@@ -442,6 +456,8 @@ void release(Shader &sh) {
 void release(Texture &tex) {
 	RELEASE(tex.srv);
 	RELEASE(tex.texture);
+	trackMemory(MemoryTag::renderer, -(s64)tex.memorySize);
+	tex.memorySize = 0;
 }
 
 void setViewport(v2u size) {
@@ -583,11 +599,8 @@ R_BIND_BUFFER {
 	CHECK_ID(buffer);
 	bind(buffers[buffer.id], stage, slot);
 }
-R_CREATE_TEXTURE_FROM_FILE {
-	PROFILE_FUNCTION;
-
-	auto tex = textures.allocate();
-	DHR(D3DX11CreateShaderResourceViewFromFileA(device, path, 0, 0, &tex->srv, 0));
+// Fills in the rest of a texture after D3DX created its view
+static TextureId initTextureFromSrv(Texture *tex, Address address, Filter filter, v4f borderColor) {
 	tex->samplerIndex = (u32)(initSampler(address, filter, borderColor) - &samplers[0][0]);
 
 	tex->srv->GetResource((ID3D11Resource **)&tex->texture);
@@ -595,9 +608,35 @@ R_CREATE_TEXTURE_FROM_FILE {
 	D3D11_TEXTURE2D_DESC desc;
 	tex->texture->GetDesc(&desc);
 	tex->rowPitch = getSize(desc.Format) * desc.Width;
+	// NOTE: top mip only
+	tex->memorySize = tex->rowPitch * desc.Height;
+	trackMemory(MemoryTag::renderer, tex->memorySize);
 
 	return {textures.indexOf(tex)};
 }
+R_CREATE_TEXTURE_FROM_FILE {
+	PROFILE_FUNCTION;
+
+	auto tex = textures.allocate();
+	DHR(D3DX11CreateShaderResourceViewFromFileA(device, path, 0, 0, &tex->srv, 0));
+	return initTextureFromSrv(tex, address, filter, borderColor);
+}
+R_CREATE_TEXTURE_TASK {
+	auto file = readEntireFile(path);
+	ASSERT(file.valid);
+
+	// NOTE: D3DX decodes and creates in one call, so only the file read is left for the worker
+	TaskGroup creation;
+	creation.push(NamedThread::main, [&] {
+		PROFILE_FUNCTION;
+		auto tex = textures.allocate();
+		DHR(D3DX11CreateShaderResourceViewFromMemory(device, file.data.data(), file.data.size(), 0, 0, &tex->srv, 0));
+		result = initTextureFromSrv(tex, address, filter, borderColor);
+	});
+	co_await creation;
+
+	freeEntireFile(file);
+}
 R_CREATE_TEXTURE {
 	auto tex = textures.allocate();
 	auto dxgiFormat = cvtFormat(format);
@@ -622,6 +661,8 @@ R_CREATE_TEXTURE {
 	}
 	tex->samplerIndex = (u32)(initSampler(address, filter, borderColor) - &samplers[0][0]);
 	tex->rowPitch = getSize(dxgiFormat) * width;
+	tex->memorySize = tex->rowPitch * height;
+	trackMemory(MemoryTag::renderer, tex->memorySize);
 
 	return {textures.indexOf(tex)};
 }
@@ -649,10 +690,7 @@ R_UNBIND_TEXTURES {
 		default: INVALID_CODE_PATH("Bad shader stage"); break;
 	}
 }
-R_CREATE_SHADER {
-	PROFILE_FUNCTION;
-	auto shader = shaders.allocate();
-
+R_CREATE_SHADER_TASK {
 	char buffer[256];
 	sprintf(buffer, "%s.hlsl", path);
 	path = buffer;
@@ -665,26 +703,42 @@ R_CREATE_SHADER {
 	for (auto &d : macros) {
 		commonDefines.push_back({d.name, d.value});
 	}
-	WorkQueue work;
-	work.push([&] {
+	ID3DBlob *vsCode = 0;
+	ID3DBlob *psCode = 0;
+	TaskGroup stages;
+	stages.push([&] {
 		auto defines = commonDefines;
 		defines.push_back({"COMPILE_VS"});
 		defines.push_back({});
-		shader->vs = createVertexShader(shaderSource.data, path, defines.data());
-		ASSERT(shader->vs);
+		vsCode = compileVertexShader(shaderSource.data, path, defines.data());
 	});
 	{
 		auto defines = commonDefines;
 		defines.push_back({"COMPILE_PS"});
 		defines.push_back({});
-		shader->ps = createPixelShader(shaderSource.data, path, defines.data());
-		ASSERT(shader->ps);
+		psCode = compilePixelShader(shaderSource.data, path, defines.data());
 	}
-	work.completeAllWork();
+	co_await stages;
 
 	freeEntireFile(shaderSource);
 
-	return {shaders.indexOf(shader)};
+	// NOTE: workers only compile, the device calls belong to the main thread
+	TaskGroup creation;
+	creation.push(NamedThread::main, [&] {
+		auto shader = shaders.allocate();
+		shader->vs = _createShader<VS>(vsCode);
+		shader->ps = _createShader<PS>(psCode);
+		result = {shaders.indexOf(shader)};
+	});
+	co_await creation;
+}
+R_CREATE_SHADER {
+	PROFILE_FUNCTION;
+	ShaderId result;
+	TaskGroup group;
+	group.push(createShaderTask(path, macros, result));
+	group.wait();
+	return result;
 }
 R_RELEASE_SHADER {
 	CHECK_ID(shader);
@@ -43,7 +43,9 @@ enum class Topology { TriangleList, LineList, count };
 #define R_CLEAR_TARGET				R_DECORATE(void, clearRenderTarget, (RenderTargetId rt, v4f color), (rt, color))
 #define R_CREATE_BUFFER				R_DECORATE(BufferId, createBuffer, (void const* data, u32 stride, u32 count), (data, stride, count))
 #define R_CREATE_SHADER				R_DECORATE(ShaderId, createShader, (char const* path, Span<ShaderMacro const> macros), (path, macros))
+#define R_CREATE_SHADER_TASK		R_DECORATE(Task, createShaderTask, (char const* path, Span<ShaderMacro const> macros, ShaderId& result), (path, macros, result))
 #define R_CREATE_TEXTURE_FROM_FILE	R_DECORATE(TextureId, createTextureFromFile, (char const* path, Address address, Filter filter, v4f borderColor), (path, address, filter, borderColor))
+#define R_CREATE_TEXTURE_TASK		R_DECORATE(Task, createTextureTask, (char const* path, Address address, Filter filter, v4f borderColor, TextureId& result), (path, address, filter, borderColor, result))
 #define R_CREATE_TEXTURE			R_DECORATE(TextureId, createTexture, (u32 width, u32 height, Format format, Address address, Filter filter, v4f borderColor), (width, height, format, address, filter, borderColor))
 #define R_CREATE_RT					R_DECORATE(RenderTargetId, createRenderTarget, (v2u size, Format format, u32 sampleCount, Address address, Filter filter, v4f borderColor), (size, format, sampleCount, address, filter, borderColor))
 #define R_DRAW						R_DECORATE(void, draw, (u32 vertexCount, u32 offset), (vertexCount, offset))
@@ -72,8 +74,10 @@ enum class Topology { TriangleList, LineList, count };
 	R_PRESENT;                  \
 	R_CLEAR_TARGET;             \
 	R_CREATE_SHADER;            \
+	R_CREATE_SHADER_TASK;       \
 	R_CREATE_RT;                \
 	R_CREATE_TEXTURE_FROM_FILE; \
+	R_CREATE_TEXTURE_TASK;      \
 	R_CREATE_TEXTURE;           \
 	R_CREATE_BUFFER;            \
 	R_UPDATE_BUFFER;            \
@@ -120,8 +124,10 @@ union Renderer {
 	FORCEINLINE void setValue(u32 slot, v4f value) { setV4f(slot, value); }
 	FORCEINLINE void draw(u32 count) { return draw(count, 0); }
 	FORCEINLINE ShaderId createShader(char const* path) { return createShader(path, {}); }
+	FORCEINLINE Task createShaderTask(char const* path, ShaderId& result) { return createShaderTask(path, {}, result); }
 	FORCEINLINE TextureId createTextureFromFile(char const* path, Address address, Filter filter) { return createTextureFromFile(path, address, filter, {}); }
 	FORCEINLINE TextureId createTexture(char const* path, Address address, Filter filter) { return createTextureFromFile(path, address, filter); }
+	FORCEINLINE Task createTextureTask(char const* path, Address address, Filter filter, TextureId& result) { return createTextureTask(path, address, filter, {}, result); }
 	FORCEINLINE TextureId createTexture(u32 width, u32 height, Format format, Address address, Filter filter) { return createTexture(width, height, format, address, filter, {}); }
 	FORCEINLINE TextureId createTexture(v2u size, Format format, Address address, Filter filter, v4f borderColor = {}) { return createTexture(size.x, size.y, format, address, filter, borderColor); }
 	FORCEINLINE RenderTargetId createRenderTarget(v2u size, Format format, Address address, Filter filter, v4f borderColor = {}) { return createRenderTarget(size, format, 1, address, filter, borderColor); }
@@ -0,0 +1,196 @@
+#pragma once
+#include "common.h"
+#include <algorithm>
+#include <iterator>
+#include <memory>
+
+// Sorting on the job system. Scratch memory comes from temp storage, so results must be used within the frame
+// like any other temp allocation. Small ranges are sorted on the calling thread.
+
+namespace Detail {
+// NOTE: below this many items per chunk scheduling costs more than the sort saves
+static constexpr u32 parallelSortGrain = 4096;
+static constexpr u32 radixDigitBits = 8;
+static constexpr u32 radixBucketCount = 1 << radixDigitBits;
+
+inline u32 getSortChunkSize(u32 count) {
+	u32 threadCount = getWorkerThreadCount() + 1;
+	return max(parallelSortGrain, (count + threadCount * parallelChunksPerThread - 1) / (threadCount * parallelChunksPerThread));
+}
+
+// Number of items taken from 'a' by the first 'k' items of merge(a, b). Ties go to 'a'.
+template <class T, class Less>
+u32 getMergeSplit(T const *a, u32 aCount, T const *b, u32 bCount, u32 k, Less &less) {
+	u32 lo = k > bCount ? k - bCount : 0;
+	u32 hi = min(k, aCount);
+	while (lo < hi) {
+		u32 i = (lo + hi) / 2;
+		if (!less(b[k - i - 1], a[i]))
+			lo = i + 1;
+		else
+			hi = i;
+	}
+	return lo;
+}
+} // namespace Detail
+
+// Sorts [begin, end) with 'less'. Chunks are sorted in parallel, then merged pairwise,
+// every merge split along its merge path so all threads take part in the last levels too.
+// NOTE: not stable, same as std::sort
+template <class T, class Less>
+void parallelSort(T *begin, T *end, Less less) {
+	u32 count = (u32)(end - begin);
+	u32 chunkSize = Detail::getSortChunkSize(count);
+	if (getWorkerThreadCount() == 0 || count <= chunkSize) {
+		std::sort(begin, end, less);
+		return;
+	}
+	u32 chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	T *scratch = allocateTemp<T>(count);
+	WorkQueue queue{JobPriority::critical};
+	queue.pushBatch(chunkCount, [&](u32 chunk) {
+		T *chunkBegin = begin + chunk * chunkSize;
+		T *chunkEnd = begin + min(count, (chunk + 1) * chunkSize);
+		std::sort(chunkBegin, chunkEnd, less);
+		std::uninitialized_move(chunkBegin, chunkEnd, scratch + (chunkBegin - begin));
+	});
+	queue.completeAllWork();
+
+	// NOTE: sorted runs ping-pong between 'scratch' and 'begin', both hold constructed objects from here on
+	T *source = scratch;
+	T *destination = begin;
+	for (u32 runSize = chunkSize; runSize < count; runSize *= 2) {
+		u32 pairCount = (count + runSize * 2 - 1) / (runSize * 2);
+		u32 piecesPerPair = (runSize * 2 + chunkSize - 1) / chunkSize;
+		auto getPair = [&, runSize](u32 pair, u32 &pairBegin, u32 &aCount, u32 &bCount) {
+			pairBegin = pair * runSize * 2;
+			aCount = min(runSize, count - pairBegin);
+			bCount = min(runSize, count - pairBegin - aCount);
+		};
+
+		// NOTE: splits are found before any piece starts moving items out of 'source', there are few enough to do it here
+		u32 *splits = allocateTemp<u32>(pairCount * (piecesPerPair + 1));
+		for (u32 pair = 0; pair < pairCount; ++pair) {
+			u32 pairBegin, aCount, bCount;
+			getPair(pair, pairBegin, aCount, bCount);
+			T *a = source + pairBegin;
+			for (u32 piece = 0; piece <= piecesPerPair; ++piece) {
+				u32 k = min(aCount + bCount, piece * chunkSize);
+				splits[pair * (piecesPerPair + 1) + piece] = Detail::getMergeSplit(a, aCount, a + aCount, bCount, k, less);
+			}
+		}
+
+		queue.pushBatch(pairCount * piecesPerPair, [&, piecesPerPair, splits](u32 index) {
+			u32 pair = index / piecesPerPair;
+			u32 piece = index % piecesPerPair;
+			u32 pairBegin, aCount, bCount;
+			getPair(pair, pairBegin, aCount, bCount);
+			u32 kBegin = min(aCount + bCount, piece * chunkSize);
+			u32 kEnd = min(aCount + bCount, kBegin + chunkSize);
+			if (kBegin == kEnd)
+				return;
+
+			T *a = source + pairBegin;
+			T *b = a + aCount;
+			u32 aBegin = splits[pair * (piecesPerPair + 1) + piece];
+			u32 aEnd = splits[pair * (piecesPerPair + 1) + piece + 1];
+			std::merge(std::make_move_iterator(a + aBegin), std::make_move_iterator(a + aEnd),
+					   std::make_move_iterator(b + kBegin - aBegin), std::make_move_iterator(b + kEnd - aEnd),
+					   destination + pairBegin + kBegin, less);
+		});
+		queue.completeAllWork();
+		std::swap(source, destination);
+	}
+
+	if (source == scratch)
+		std::move(scratch, scratch + count, begin);
+	std::destroy(scratch, scratch + count);
+}
+template <class T>
+void parallelSort(T *begin, T *end) {
+	parallelSort(begin, end, std::less<T>{});
+}
+
+// Maps floats to unsigned keys with the same order, negative values included
+inline u32 toRadixKey(f32 value) {
+	u32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits ^ ((u32)((s32)bits >> 31) | 0x80000000u);
+}
+
+// Stable LSD radix sort of [begin, end) by 'key(T const &)', which returns u32 or u64.
+// Every 8 bit digit is a histogram pass and a scatter pass over the same chunks, digits all items share are skipped.
+// NOTE: 'T' is moved around with memcpy, 'key' is called once per item per pass
+template <class T, class KeyFn>
+void radixSort(T *begin, T *end, KeyFn key) {
+	static_assert(std::is_trivially_copyable_v<T>, "radixSort moves items with memcpy");
+	using Key = decltype(key(*begin));
+	static_assert(std::is_same_v<Key, u32> || std::is_same_v<Key, u64>, "radix key must be u32 or u64");
+	constexpr u32 passCount = sizeof(Key) * 8 / Detail::radixDigitBits;
+
+	u32 count = (u32)(end - begin);
+	if (count <= 1)
+		return;
+	u32 chunkSize = getWorkerThreadCount() == 0 ? count : Detail::getSortChunkSize(count);
+	u32 chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	T *scratch = allocateTemp<T>(count);
+	// NOTE: per chunk bucket counts, turned into per chunk write offsets before the scatter
+	u32 *offsets = allocateTemp<u32>(chunkCount * Detail::radixBucketCount);
+
+	WorkQueue queue{JobPriority::critical};
+	auto forEachChunk = [&](auto fn) {
+		if (chunkCount == 1) {
+			fn(0u);
+		} else {
+			queue.pushBatch(chunkCount, fn);
+			queue.completeAllWork();
+		}
+	};
+
+	T *source = begin;
+	T *destination = scratch;
+	for (u32 pass = 0; pass < passCount; ++pass) {
+		u32 shift = pass * Detail::radixDigitBits;
+		memset(offsets, 0, chunkCount * Detail::radixBucketCount * sizeof(u32));
+		forEachChunk([&](u32 chunk) {
+			u32 *counts = offsets + chunk * Detail::radixBucketCount;
+			T *chunkEnd = source + min(count, (chunk + 1) * chunkSize);
+			for (T *it = source + chunk * chunkSize; it != chunkEnd; ++it)
+				++counts[(key(*it) >> shift) & (Detail::radixBucketCount - 1)];
+		});
+
+		u32 offset = 0;
+		bool allInOneBucket = false;
+		for (u32 bucket = 0; bucket < Detail::radixBucketCount; ++bucket) {
+			u32 bucketBegin = offset;
+			for (u32 chunk = 0; chunk < chunkCount; ++chunk) {
+				u32 &slot = offsets[chunk * Detail::radixBucketCount + bucket];
+				u32 chunkBucketCount = slot;
+				slot = offset;
+				offset += chunkBucketCount;
+			}
+			if (offset - bucketBegin == count)
+				allInOneBucket = true;
+		}
+		if (allInOneBucket)
+			continue;
+
+		forEachChunk([&](u32 chunk) {
+			u32 *chunkOffsets = offsets + chunk * Detail::radixBucketCount;
+			T *chunkEnd = source + min(count, (chunk + 1) * chunkSize);
+			for (T *it = source + chunk * chunkSize; it != chunkEnd; ++it)
+				memcpy(destination + chunkOffsets[(key(*it) >> shift) & (Detail::radixBucketCount - 1)]++, it, sizeof(T));
+		});
+		std::swap(source, destination);
+	}
+	if (source == scratch)
+		memcpy(begin, scratch, count * sizeof(T));
+}
+inline void radixSort(u32 *begin, u32 *end) {
+	radixSort(begin, end, [](u32 value) { return value; });
+}
+inline void radixSort(u64 *begin, u64 *end) {
+	radixSort(begin, end, [](u64 value) { return value; });
+}
@@ -314,14 +314,14 @@ struct Win32Game {
 		void debugUpdate(Window &window, Renderer &renderer, Input &input, Time &time, Profiler::Stats const &start, Profiler::Stats const &stats) { _debugUpdate(*this, window, renderer, input, time, start, stats); }
 	} state;
 	
-	String<> gameLibName;
+	String<HeapAllocator> gameLibName;
 
 	void init() {
 		auto lib = LoadLibraryA("game.dll");
 		ASSERT(lib);
 		DEFER { FreeLibrary(lib); };
 
-		StringBuilder<OsAllocator> builder;
+		StringBuilder<HeapAllocator> builder;
 		builder.append(((decltype(GameApi::getName) *)GetProcAddress(lib, "getName"))());
 		builder.append(".dll");
 		gameLibName = builder.getTerminated();
@@ -546,6 +546,85 @@ Renderer createRenderer(RenderingApi renderingApi, Window &window, u32 sampleCou
 
 void printMemoryUsage() {
 	Log::print("Memory usage: {}", cvtBytes(getMemoryUsage()));
+	auto largePages = getLargePageStats();
+	if (largePages.allocations || largePages.fallbacks)
+		Log::print("    large pages: {}, {} allocations, {} fallbacks", cvtBytes(largePages.liveBytes), largePages.allocations, largePages.fallbacks);
+	auto heap = getHeapStats();
+	Log::print("    heap: {} in chunks, {} large, {} refills, {} flushes", cvtBytes(heap.chunkBytes), cvtBytes(heap.largeBytes), heap.refills, heap.flushes);
+	for (u32 tag = 0; tag < (u32)MemoryTag::count; ++tag) {
+		auto stats = getMemoryTagStats((MemoryTag)tag);
+		if (stats.allocationCount)
+			Log::print("    {}: {}, peak {}, {} allocations", toString((MemoryTag)tag), cvtBytes(stats.liveBytes), cvtBytes(stats.peakBytes), stats.allocationCount);
+	}
+}
+void benchmarkWorkQueue() {
+	u32 const jobCount = 1024 * 256;
+	u32 const nestedJobCount = 64;
+	u32 volatile counter = 0;
+
+	PerfTimer timer;
+	WorkQueue queue{};
+	for (u32 i = 0; i < jobCount; ++i) {
+		queue.push([&counter] { InterlockedIncrement(&counter); });
+	}
+	queue.completeAllWork();
+	f32 flatMs = timer.getMilliseconds();
+	resetTempStorage();
+
+	timer.reset();
+	for (u32 i = 0; i < jobCount / nestedJobCount; ++i) {
+		queue.push([&counter, nestedJobCount] {
+			WorkQueue nested{};
+			for (u32 j = 0; j < nestedJobCount; ++j) {
+				nested.push([&counter] { InterlockedIncrement(&counter); });
+			}
+			nested.completeAllWork();
+		});
+	}
+	queue.completeAllWork();
+	f32 nestedMs = timer.getMilliseconds();
+	resetTempStorage();
+
+	ASSERT(counter == jobCount * 2);
+	Log::print("WorkQueue: {} jobs on {} workers", jobCount, getWorkerThreadCount());
+	Log::print("    flat:   {} ms, {} jobs/ms", flatMs, jobCount / flatMs);
+	Log::print("    nested: {} ms, {} jobs/ms", nestedMs, jobCount / nestedMs);
+}
+void benchmarkJobSubmission() {
+	u32 const jobCount = 1024 * 256;
+	u32 volatile counter = 0;
+
+	auto job = [&counter] { InterlockedIncrement(&counter); };
+	using Job = decltype(job);
+
+	WorkQueue queue{};
+	auto run = [&](bool inlineStorage, f32 &pushMs, f32 &totalMs) {
+		PerfTimer timer;
+		for (u32 i = 0; i < jobCount; ++i) {
+			if (inlineStorage) {
+				queue.push(job);
+			} else {
+				// NOTE: same as WorkQueue::push did before inline slots
+				auto param = allocateTemp(sizeof(Job), alignof(Job));
+				new (param) Job(job);
+				queue.push_([](void *param) { (*(Job *)param)(); }, param);
+			}
+		}
+		pushMs = timer.getMilliseconds();
+		queue.completeAllWork();
+		totalMs = timer.getMilliseconds();
+		resetTempStorage();
+	};
+
+	f32 inlinePushMs, inlineTotalMs;
+	f32 allocatedPushMs, allocatedTotalMs;
+	run(false, allocatedPushMs, allocatedTotalMs);
+	run(true, inlinePushMs, inlineTotalMs);
+
+	ASSERT(counter == jobCount * 2);
+	Log::print("Job submission: {} jobs on {} workers", jobCount, getWorkerThreadCount());
+	Log::print("    allocated: push {} ms, push + execute {} ms, {} jobs/ms", allocatedPushMs, allocatedTotalMs, jobCount / allocatedTotalMs);
+	Log::print("    inline:    push {} ms, push + execute {} ms, {} jobs/ms", inlinePushMs, inlineTotalMs, jobCount / inlineTotalMs);
 }
 int WINAPI WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
 	printMemoryUsage();
@@ -583,17 +662,35 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
 		startInfo.renderingApi = RenderingApi::d3d11;
 		startInfo.backBufferFormat = Format::UN_RGBA8;
 		startInfo.backBufferSampleCount = 1;
-		startInfo.workerThreadCount = cpuInfo.logicalProcessorCount - 1;
+		startInfo.workerPlacement.placement = WorkerPlacement::logicalCores;
+		startInfo.workerThreadCount = getPlacementThreadCount(startInfo.workerPlacement) - 1;
 
 		game.state.fillStartInfo(startInfo);
 
+		// NOTE: needs the "Lock pages in memory" right, without it everything stays on normal pages
+		if (startInfo.largePages) {
+			if (enableLargePages()) {
+				Log::print("Large pages: {}", cvtBytes(getLargePageStats().pageSize));
+				setTempStorageLargePages(true);
+			} else {
+				Log::print("Large pages: unavailable");
+			}
+		}
+
 		printMemoryUsage();
 
-		initWorkerThreads(startInfo.workerThreadCount);
+		initWorkerThreads(startInfo.workerThreadCount, startInfo.workerPlacement);
 		DEFER { shutdownWorkerThreads(); };
 		
 		printMemoryUsage();
+
+#if 0
+		benchmarkWorkQueue();
+		benchmarkJobSubmission();
+#endif
 		
+		PerfTimer startupTimer;
+
 		Profiler::init(startInfo.workerThreadCount + 1);
 		PROFILE_BEGIN("mainStartup");
 		
@@ -662,6 +759,8 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
 
 		game.state.start(window, renderer, input, time);
 		DEFER { game.state.shutdown(); };
+
+		Log::print("Startup: {} ms", startupTimer.getMilliseconds());
 		
 		Profiler::Stats startStats = Profiler::getStats();
 		game.state.debugStart(window, renderer, input, time, startStats);
@@ -675,7 +774,10 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int) {
 		s64 lastPerfCounter = PerfTimer::getCounter();
 		while (window.open) {
 			Profiler::reset();
+			updateWorkerStats();
 			resetTempStorage();
+			advanceFrameStorage();
+			runThreadJobs(NamedThread::main);
 
 			game.checkUpdate();
 			if (game.state.forceReload) {